@@ -0,0 +1,382 @@
+#include <MelonTask/Task.h>
+#include <MelonTask/TaskGraph.h>
+#include <MelonTask/TaskGroup.h>
+#include <MelonTask/TaskHandle.h>
+#include <MelonTask/TaskManager.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr unsigned int k_IterationCount = 10;
+
+// Run the benchmark several times and return the best duration in seconds
+double measure(const std::function<void()>& benchmark) {
+    double bestDuration = std::numeric_limits<double>::max();
+    for (unsigned int i = 0; i < k_IterationCount; i++) {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        benchmark();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        bestDuration = std::min(bestDuration, std::chrono::duration<double>(end - begin).count());
+    }
+    return bestDuration;
+}
+
+// Collected for the JSON output, metrics are kept in the order they are reported
+struct Result {
+    std::string name;
+    unsigned int workerCount;
+    std::vector<std::pair<const char*, double>> metrics;
+};
+
+std::vector<Result> g_Results;
+// Set by benchmarks which also check the behavior of the scheduler
+bool g_Failed{};
+
+void report(const Melon::TaskManager& taskManager, const char* name, const unsigned int& taskCount, const double& duration) {
+    std::printf("%-24s %3u workers %10u tasks %10.3f ms %12.0f tasks/s %8.1f ns/task\n", name, taskManager.workerCount(), taskCount, duration * 1e3, taskCount / duration, duration * 1e9 / taskCount);
+    g_Results.push_back(Result{name, taskManager.workerCount(), {{"tasks", taskCount}, {"seconds", duration}, {"tasksPerSecond", taskCount / duration}, {"nsPerTask", duration * 1e9 / taskCount}}});
+}
+
+void writeJson(std::FILE* file) {
+    std::fprintf(file, "{\n  \"hardwareConcurrency\": %u,\n  \"iterationCount\": %u,\n  \"benchmarks\": [", std::thread::hardware_concurrency(), k_IterationCount);
+    for (unsigned int i = 0; i < g_Results.size(); i++) {
+        std::fprintf(file, "%s\n    {\"name\": \"%s\", \"workers\": %u", i == 0 ? "" : ",", g_Results[i].name.c_str(), g_Results[i].workerCount);
+        for (const auto& [key, value] : g_Results[i].metrics)
+            std::fprintf(file, ", \"%s\": %.9g", key, value);
+        std::fprintf(file, "}");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+}
+
+// Independent tasks which do nearly nothing, stress the queue
+void tinyTasks(Melon::TaskManager& taskManager, const unsigned int& taskCount) {
+    std::atomic<unsigned int> counter{};
+    const double duration = measure([&]() {
+        std::vector<std::shared_ptr<Melon::TaskHandle>> taskHandles(taskCount);
+        for (unsigned int i = 0; i < taskCount; i++)
+            taskHandles[i] = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+        std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.combine(taskHandles);
+        taskManager.activateWaitingTasks();
+        taskHandle->complete();
+    });
+    report(taskManager, "TinyTasks", taskCount, duration);
+}
+
+// Same tasks as TinyTasks submitted with scheduleBatch, stress the bulk queueing
+void batchedTasks(Melon::TaskManager& taskManager, const unsigned int& taskCount) {
+    std::atomic<unsigned int> counter{};
+    auto increment = [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); };
+    std::vector<decltype(increment)> procedures(taskCount, increment);
+    const double duration = measure([&]() {
+        std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.scheduleBatch(std::span(procedures));
+        taskManager.activateWaitingTasks();
+        taskHandle->complete();
+    });
+    report(taskManager, "BatchedTasks", taskCount, duration);
+}
+
+// Several chains in which every task depends on the previous one, stress the successor path
+void deepChains(Melon::TaskManager& taskManager, const unsigned int& chainCount, const unsigned int& chainLength) {
+    std::atomic<unsigned int> counter{};
+    const double duration = measure([&]() {
+        std::vector<std::shared_ptr<Melon::TaskHandle>> tails(chainCount);
+        for (unsigned int i = 0; i < chainCount; i++) {
+            std::shared_ptr<Melon::TaskHandle> taskHandle;
+            for (unsigned int j = 0; j < chainLength; j++)
+                taskHandle = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {taskHandle});
+            tails[i] = taskHandle;
+        }
+        std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.combine(tails);
+        taskManager.activateWaitingTasks();
+        taskHandle->complete();
+    });
+    report(taskManager, "DeepChains", chainCount * chainLength, duration);
+}
+
+// Rounds in which a task fans out to many tasks which are joined by combine, each round depends on the previous join
+void fanOutFanIn(Melon::TaskManager& taskManager, const unsigned int& roundCount, const unsigned int& fanCount) {
+    std::atomic<unsigned int> counter{};
+    const double duration = measure([&]() {
+        std::shared_ptr<Melon::TaskHandle> join;
+        for (unsigned int i = 0; i < roundCount; i++) {
+            std::shared_ptr<Melon::TaskHandle> root = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {join});
+            std::vector<std::shared_ptr<Melon::TaskHandle>> fan(fanCount);
+            for (unsigned int j = 0; j < fanCount; j++)
+                fan[j] = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {root});
+            join = taskManager.combine(fan);
+        }
+        taskManager.activateWaitingTasks();
+        join->complete();
+    });
+    report(taskManager, "FanOutFanIn/Combine", roundCount * (fanCount + 2), duration);
+}
+
+// The same rounds joined by a TaskGroup, in which the join is a counter instead of a task
+void fanOutFanInGroups(Melon::TaskManager& taskManager, const unsigned int& roundCount, const unsigned int& fanCount) {
+    std::atomic<unsigned int> counter{};
+    const double duration = measure([&]() {
+        std::shared_ptr<Melon::TaskHandle> join;
+        for (unsigned int i = 0; i < roundCount; i++) {
+            std::shared_ptr<Melon::TaskHandle> root = taskManager.spawn([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {join});
+            Melon::TaskGroup taskGroup(&taskManager);
+            for (unsigned int j = 0; j < fanCount; j++)
+                taskGroup.spawn([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {root});
+            join = taskGroup.join();
+        }
+        join->complete();
+    });
+    report(taskManager, "FanOutFanIn/TaskGroup", roundCount * (fanCount + 1), duration);
+}
+
+// Independent chains of diamonds, in which a task has two successors joined by the top of the next diamond
+void diamondDags(Melon::TaskManager& taskManager, const unsigned int& dagCount, const unsigned int& diamondCount) {
+    std::atomic<unsigned int> counter{};
+    const double duration = measure([&]() {
+        std::vector<std::shared_ptr<Melon::TaskHandle>> bottoms(dagCount);
+        for (unsigned int i = 0; i < dagCount; i++) {
+            std::shared_ptr<Melon::TaskHandle> top = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+            for (unsigned int j = 0; j < diamondCount; j++) {
+                std::shared_ptr<Melon::TaskHandle> left = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {top});
+                std::shared_ptr<Melon::TaskHandle> right = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {top});
+                top = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, {left, right});
+            }
+            bottoms[i] = top;
+        }
+        std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.combine(bottoms);
+        taskManager.activateWaitingTasks();
+        taskHandle->complete();
+    });
+    report(taskManager, "DiamondDags", dagCount * (diamondCount * 3 + 1), duration);
+}
+
+// Small per-frame DAGs, in which a fan of tasks is joined by a single task, built each frame
+void scheduledFrames(Melon::TaskManager& taskManager, const unsigned int& frameCount, const unsigned int& fanCount) {
+    std::atomic<unsigned int> counter{};
+    const double duration = measure([&]() {
+        for (unsigned int i = 0; i < frameCount; i++) {
+            std::vector<std::shared_ptr<Melon::TaskHandle>> fan(fanCount);
+            for (unsigned int j = 0; j < fanCount; j++)
+                fan[j] = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+            std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.schedule([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, fan);
+            taskManager.activateWaitingTasks();
+            taskHandle->complete();
+        }
+    });
+    report(taskManager, "ScheduledFrames", frameCount * (fanCount + 1), duration);
+}
+
+// The same DAGs recorded once and replayed each frame
+void replayedFrames(Melon::TaskManager& taskManager, const unsigned int& frameCount, const unsigned int& fanCount) {
+    std::atomic<unsigned int> counter{};
+    Melon::TaskGraph taskGraph(&taskManager);
+    std::vector<unsigned int> fan(fanCount);
+    for (unsigned int j = 0; j < fanCount; j++)
+        fan[j] = taskGraph.record([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+    taskGraph.record([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); }, fan);
+    const std::vector<std::shared_ptr<Melon::TaskHandle>> predecessors;
+    const double duration = measure([&]() {
+        for (unsigned int i = 0; i < frameCount; i++)
+            taskGraph.run(predecessors)->complete();
+    });
+    report(taskManager, "ReplayedFrames", frameCount * (fanCount + 1), duration);
+}
+
+// Binary tree of tasks, in which each task spawns two children and waits for them, stress nested spawning
+void recursiveSpawn(Melon::TaskManager& taskManager, const unsigned int& depth) {
+    std::atomic<unsigned int> counter{};
+    std::function<void(unsigned int)> node = [&](unsigned int level) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+        if (level == 0) return;
+        std::shared_ptr<Melon::TaskHandle> left = taskManager.spawn([&node, level]() { node(level - 1); });
+        std::shared_ptr<Melon::TaskHandle> right = taskManager.spawn([&node, level]() { node(level - 1); });
+        left->complete();
+        right->complete();
+    };
+    const double duration = measure([&]() {
+        taskManager.spawn([&node, depth]() { node(depth); })->complete();
+    });
+    report(taskManager, "RecursiveSpawn", (2U << depth) - 1, duration);
+}
+
+// Coroutine which awaits spawned tasks one by one, stress suspending and resuming
+Melon::Task<unsigned int> awaitChain(Melon::TaskManager& taskManager, const unsigned int taskCount) {
+    unsigned int counter = 0;
+    for (unsigned int i = 0; i < taskCount; i++)
+        co_await taskManager.spawn([&counter]() { counter++; });
+    co_return counter;
+}
+
+void coroutineChain(Melon::TaskManager& taskManager, const unsigned int& taskCount) {
+    const double duration = measure([&]() {
+        Melon::Task<unsigned int> task = awaitChain(taskManager, taskCount);
+        task.start(&taskManager)->complete();
+    });
+    report(taskManager, "CoroutineChain", taskCount, duration);
+}
+
+// Blocks of a parallelFor which gather into a temporary buffer, compare the heap with the scratch arena of workers
+void scratchBuffers(Melon::TaskManager& taskManager, const unsigned int& blockCount, const unsigned int& bufferSize) {
+    std::atomic<unsigned int> checksum{};
+    auto gather = [&checksum](unsigned int* buffer, const unsigned int size, const unsigned int block) {
+        for (unsigned int i = 0; i < size; i++)
+            buffer[i] = block ^ i;
+        checksum.fetch_add(buffer[size / 2], std::memory_order_relaxed);
+    };
+    double duration = measure([&]() {
+        std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.parallelFor(0, blockCount, 1, [&](const unsigned int& begin, const unsigned int&) {
+            std::unique_ptr<unsigned int[]> buffer = std::make_unique_for_overwrite<unsigned int[]>(bufferSize);
+            gather(buffer.get(), bufferSize, begin);
+        });
+        taskManager.activateWaitingTasks();
+        taskHandle->complete();
+    });
+    report(taskManager, "ScratchBuffers/Heap", blockCount, duration);
+    duration = measure([&]() {
+        std::shared_ptr<Melon::TaskHandle> taskHandle = taskManager.parallelFor(0, blockCount, 1, [&](const unsigned int& begin, const unsigned int&) {
+            gather(Melon::currentWorkerArena().allocate<unsigned int>(bufferSize), bufferSize, begin);
+        });
+        taskManager.activateWaitingTasks();
+        taskHandle->complete();
+    });
+    report(taskManager, "ScratchBuffers/Arena", blockCount, duration);
+}
+
+// Two blocks of a parallelFor started while workers are parked, the upper half of the split should be taken by another worker
+void parallelForSpread(Melon::TaskManager& taskManager, const std::chrono::microseconds& idleDuration, const std::chrono::microseconds& blockDuration, const unsigned int& sampleCount) {
+    taskManager.setIdlePolicy(Melon::TaskIdlePolicy{0, 0});
+    unsigned int spreadCount = 0;
+    for (unsigned int i = 0; i < sampleCount; i++) {
+        std::this_thread::sleep_for(idleDuration);
+        std::array<unsigned int, 2> threadIndices{};
+        std::atomic<unsigned int> finishedCount{};
+        taskManager.parallelFor(0, 2, 1, [&](const unsigned int& begin, const unsigned int&) {
+            threadIndices[begin] = taskManager.currentThreadIndex();
+            const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + blockDuration;
+            while (std::chrono::steady_clock::now() < end) {}
+            finishedCount.fetch_add(1, std::memory_order_release);
+            finishedCount.notify_one();
+        });
+        taskManager.activateWaitingTasks();
+        // Not TaskHandle::complete(), the main thread would take blocks by itself
+        for (unsigned int count = 0; (count = finishedCount.load(std::memory_order_acquire)) < 2;)
+            finishedCount.wait(count);
+        if (threadIndices[0] != threadIndices[1])
+            spreadCount++;
+    }
+    taskManager.setIdlePolicy(Melon::TaskIdlePolicy{});
+    std::printf("%-24s %3u workers %10u splits %10u spread\n", "ParallelFor/Spread", taskManager.workerCount(), sampleCount, spreadCount);
+    g_Results.push_back(Result{"ParallelFor/Spread", taskManager.workerCount(), {{"samples", sampleCount}, {"spread", spreadCount}}});
+    if (taskManager.workerCount() > 1 && spreadCount == 0) {
+        std::fprintf(stderr, "ParallelFor/Spread: the upper halves never ran on another worker\n");
+        g_Failed = true;
+    }
+}
+
+// Median time from spawning a task to its execution, after workers have been idle for a while
+void wakeLatency(Melon::TaskManager& taskManager, const char* name, const Melon::TaskIdlePolicy& idlePolicy, const std::chrono::microseconds& idleDuration, const unsigned int& sampleCount) {
+    taskManager.setIdlePolicy(idlePolicy);
+    std::vector<double> latencies(sampleCount);
+    // Outside the loop, the task may still be notifying after the wait returns
+    std::chrono::steady_clock::time_point executed;
+    std::atomic<bool> finished;
+    for (unsigned int i = 0; i < sampleCount; i++) {
+        // Keep the main thread busy instead of sleeping, like the rest of a frame
+        const std::chrono::steady_clock::time_point idleEnd = std::chrono::steady_clock::now() + idleDuration;
+        while (std::chrono::steady_clock::now() < idleEnd)
+            ;
+        finished = false;
+        const std::chrono::steady_clock::time_point spawned = std::chrono::steady_clock::now();
+        taskManager.spawn([&executed, &finished]() {
+            executed = std::chrono::steady_clock::now();
+            finished = true;
+            finished.notify_one();
+        });
+        // Not TaskHandle::complete(), which executes the task on this thread
+        finished.wait(false);
+        latencies[i] = std::chrono::duration<double>(executed - spawned).count();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const double median = latencies[sampleCount / 2];
+    const double p90 = latencies[sampleCount * 9 / 10];
+    std::printf("%-24s %3u workers %10u wakes %10.3f us median %10.3f us p90\n", name, taskManager.workerCount(), sampleCount, median * 1e6, p90 * 1e6);
+    g_Results.push_back(Result{name, taskManager.workerCount(), {{"samples", sampleCount}, {"medianSeconds", median}, {"p90Seconds", p90}}});
+}
+
+void runSuite(const unsigned int& workerCount) {
+    Melon::TaskManagerConfiguration configuration;
+    configuration.workerCount = workerCount;
+    Melon::TaskManager taskManager(configuration);
+    tinyTasks(taskManager, 100000);
+    batchedTasks(taskManager, 100000);
+    deepChains(taskManager, 8, 10000);
+    fanOutFanIn(taskManager, 1000, 64);
+    fanOutFanInGroups(taskManager, 1000, 64);
+    diamondDags(taskManager, 64, 512);
+    scheduledFrames(taskManager, 10000, 8);
+    replayedFrames(taskManager, 10000, 8);
+    recursiveSpawn(taskManager, 16);
+    coroutineChain(taskManager, 10000);
+    scratchBuffers(taskManager, 100000, 1024);
+    parallelForSpread(taskManager, std::chrono::microseconds(200), std::chrono::microseconds(2000), 100);
+    wakeLatency(taskManager, "WakeLatency/Park", Melon::TaskIdlePolicy{0, 0}, std::chrono::microseconds(200), 1000);
+    wakeLatency(taskManager, "WakeLatency/Yield", Melon::TaskIdlePolicy{0, 1024}, std::chrono::microseconds(200), 1000);
+    wakeLatency(taskManager, "WakeLatency/SpinThenPark", Melon::TaskIdlePolicy{}, std::chrono::microseconds(200), 1000);
+}
+
+}  // namespace
+
+// Usage: MelonTaskBenchmarks [--workers 1,2,4] [--json results.json]
+// Worker counts default to powers of two up to the core count, and the core count itself
+int main(int argc, char** argv) {
+    std::vector<unsigned int> workerCounts;
+    const char* jsonPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view argument(argv[i]);
+        if (argument == "--workers" && i + 1 < argc) {
+            for (char* list = argv[++i]; *list != '\0';) {
+                workerCounts.push_back(static_cast<unsigned int>(std::strtoul(list, &list, 10)));
+                if (*list == ',') list++;
+            }
+        } else if (argument == "--json" && i + 1 < argc)
+            jsonPath = argv[++i];
+        else {
+            std::fprintf(stderr, "Usage: %s [--workers 1,2,4] [--json results.json]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (workerCounts.empty()) {
+        const unsigned int coreCount = std::max(std::thread::hardware_concurrency(), 1U);
+        for (unsigned int workerCount = 1; workerCount < coreCount; workerCount *= 2)
+            workerCounts.push_back(workerCount);
+        workerCounts.push_back(coreCount);
+    }
+
+    for (const unsigned int& workerCount : workerCounts)
+        runSuite(std::max(workerCount, 1U));
+
+    if (jsonPath) {
+        std::FILE* file = std::fopen(jsonPath, "w");
+        if (!file) {
+            std::fprintf(stderr, "Failed to open %s\n", jsonPath);
+            return 1;
+        }
+        writeJson(file);
+        std::fclose(file);
+    }
+    return g_Failed ? 1 : 0;
+}
@@ -35,8 +35,7 @@ class SpeedSystem : public Melon::SystemBase {
         Melon::Archetype* archetype = entityManager()->createArchetypeBuilder().markComponents<Speed>().createArchetype();
 
         std::array<Melon::Entity, 1024> entities;
-        for (unsigned int i = 0; i < entities.size(); i++)
-            entities[i] = entityManager()->createEntity(archetype);
+        entityManager()->createEntities(archetype, entities);
         for (unsigned int i = 0; i * 3 < entities.size(); i++) {
             entityManager()->setComponent(entities[i], Speed{.value = i % 10});
             entityManager()->addComponent(entities[i], Melon::Translation{.value = glm::vec3(i % 10 + 10, i % 10 + 20, i % 10 + 30)});
@@ -71,26 +71,26 @@ class SpawnerAndKillSystem : public Melon::SystemBase {
         for (unsigned int i = 2; i < entities.size(); i += 3)
             entityManager()->setComponent(entities[i], Spawner{.initialHealth = 1, .spawnerCount = 4});
 
-        m_SpawnerEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<Spawner>().createEntityFilter();
-        m_MonsterEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<Health>().createEntityFilter();
+        m_SpawnerEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<Spawner>().createEntityQuery();
+        m_MonsterEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<Health>().createEntityQuery();
         m_SpawnerComponentId = entityManager()->componentId<Spawner>();
         m_HealthComponentId = entityManager()->componentId<Health>();
     }
 
     void onUpdate() override {
         printf("Delta time : %f\n", time()->deltaTime());
-        std::shared_ptr<Melon::TaskHandle> spawnerTaskHandle = schedule(std::make_shared<SpawnerEntityCommandBufferChunkTask>(m_SpawnerComponentId), m_SpawnerEntityFilter, predecessor());
-        std::shared_ptr<Melon::TaskHandle> killTaskHandle = schedule(std::make_shared<KillEntityCommandBufferChunkTask>(m_HealthComponentId), m_MonsterEntityFilter, predecessor());
+        std::shared_ptr<Melon::TaskHandle> spawnerTaskHandle = schedule(std::make_shared<SpawnerEntityCommandBufferChunkTask>(m_SpawnerComponentId), m_SpawnerEntityQuery, predecessor());
+        std::shared_ptr<Melon::TaskHandle> killTaskHandle = schedule(std::make_shared<KillEntityCommandBufferChunkTask>(m_HealthComponentId), m_MonsterEntityQuery, predecessor());
         predecessor() = taskManager()->combine({spawnerTaskHandle, killTaskHandle});
-        if (entityManager()->entityCount(m_SpawnerEntityFilter) == 0 && entityManager()->entityCount(m_MonsterEntityFilter) == 0)
+        if (entityManager()->entityCount(m_SpawnerEntityQuery) == 0 && entityManager()->entityCount(m_MonsterEntityQuery) == 0)
             instance()->quit();
     }
 
     void onExit() override {}
 
   private:
-    Melon::EntityFilter m_SpawnerEntityFilter;
-    Melon::EntityFilter m_MonsterEntityFilter;
+    Melon::EntityQuery* m_SpawnerEntityQuery;
+    Melon::EntityQuery* m_MonsterEntityQuery;
     unsigned int m_SpawnerComponentId;
     unsigned int m_HealthComponentId;
     unsigned int m_Counter{};
@@ -90,8 +90,8 @@ class MonsterDamageCounterSystem : public Melon::SystemBase {
         entityManager()->setComponent(entities[3], PersistentDamage{.value = 2});
         entityManager()->setComponent(entities[3], ManualDamageCounter{.index = 3});
 
-        m_MonsterEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<MonsterHealth, PersistentDamage, ManualDamageCounter>().createEntityFilter();
-        m_CollectCounterEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<ManualDamageCounter>().rejectComponents<MonsterHealth>().createEntityFilter();
+        m_MonsterEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<MonsterHealth, PersistentDamage, ManualDamageCounter>().createEntityQuery();
+        m_CollectCounterEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<ManualDamageCounter>().rejectComponents<MonsterHealth>().createEntityQuery();
         m_MonsterHealthComponentId = entityManager()->componentId<MonsterHealth>();
         m_PersistentDamageComponentId = entityManager()->componentId<PersistentDamage>();
         m_ManualDamageCounterComponentId = entityManager()->componentId<ManualDamageCounter>();
@@ -101,10 +101,10 @@ class MonsterDamageCounterSystem : public Melon::SystemBase {
 
     void onUpdate() override {
         printf("Delta time : %f\n", time()->deltaTime());
-        std::shared_ptr<Melon::TaskHandle> damageTaskHandle = schedule(std::make_shared<DamageEntityCommandBufferChunkTask>(m_MonsterHealthComponentId, m_PersistentDamageComponentId, m_ManualDamageCounterComponentId), m_MonsterEntityFilter, predecessor());
-        std::shared_ptr<Melon::TaskHandle> counterTaskHandle = schedule(std::make_shared<CollectCounterCommandBufferChunkTask>(m_ManualDamageCounterComponentId, m_DamageTakenCounts), m_CollectCounterEntityFilter, predecessor());
+        std::shared_ptr<Melon::TaskHandle> damageTaskHandle = schedule(std::make_shared<DamageEntityCommandBufferChunkTask>(m_MonsterHealthComponentId, m_PersistentDamageComponentId, m_ManualDamageCounterComponentId), m_MonsterEntityQuery, predecessor());
+        std::shared_ptr<Melon::TaskHandle> counterTaskHandle = schedule(std::make_shared<CollectCounterCommandBufferChunkTask>(m_ManualDamageCounterComponentId, m_DamageTakenCounts), m_CollectCounterEntityQuery, predecessor());
         predecessor() = taskManager()->combine({damageTaskHandle, counterTaskHandle});
-        if (entityManager()->entityCount(m_MonsterEntityFilter) == 0 && entityManager()->entityCount(m_CollectCounterEntityFilter) == 0) {
+        if (entityManager()->entityCount(m_MonsterEntityQuery) == 0 && entityManager()->entityCount(m_CollectCounterEntityQuery) == 0) {
             printf("Damage taken counts: ");
             for (const unsigned int& damageTakenCount : m_DamageTakenCounts)
                 printf("%d ", damageTakenCount);
@@ -116,8 +116,8 @@ class MonsterDamageCounterSystem : public Melon::SystemBase {
     void onExit() override {}
 
   private:
-    Melon::EntityFilter m_MonsterEntityFilter;
-    Melon::EntityFilter m_CollectCounterEntityFilter;
+    Melon::EntityQuery* m_MonsterEntityQuery;
+    Melon::EntityQuery* m_CollectCounterEntityQuery;
     unsigned int m_MonsterHealthComponentId;
     unsigned int m_PersistentDamageComponentId;
     unsigned int m_ManualDamageCounterComponentId;
@@ -1,6 +1,7 @@
 #include <MelonCore/Archetype.h>
 
 #include <algorithm>
+#include <numeric>
 
 namespace Melon {
 
@@ -11,29 +12,36 @@ Archetype::Archetype(
     std::vector<std::size_t> const& componentSizes,
     std::vector<std::size_t> const& componentAligns,
     std::vector<unsigned int> const& sharedComponentIds,
-    ObjectPool<Chunk>* chunkPool)
-    : m_Id(id), m_Mask(mask), m_ComponentIds(componentIds), m_ComponentSizes(componentSizes), m_ComponentAligns(componentAligns), m_SharedComponentIds(sharedComponentIds), m_ChunkPool(chunkPool) {
-    m_ChunkLayout.componentSizes = componentSizes;
+    ObjectPool<Chunk>* chunkPool,
+    const unsigned int& version)
+    : m_Id(id), m_Mask(mask), m_ComponentIds(componentIds), m_ComponentSizes(componentSizes), m_ComponentAligns(componentAligns), m_SharedComponentIds(sharedComponentIds), m_ChunkPool(chunkPool), m_Version(version) {
+    // Lay out components in ascending id order so lookups and moves need no map
+    std::vector<unsigned int> order(componentIds.size());
+    std::iota(order.begin(), order.end(), 0U);
+    std::sort(order.begin(), order.end(), [&componentIds](const unsigned int& a, const unsigned int& b) { return componentIds[a] < componentIds[b]; });
+    m_ChunkLayout.componentIds.resize(componentIds.size());
+    m_ChunkLayout.componentSizes.resize(componentIds.size());
+    m_ChunkLayout.componentOffsets.resize(componentIds.size());
     std::size_t totalSize = sizeof(Entity);
-    for (const std::size_t& size : m_ChunkLayout.componentSizes)
-        totalSize += size;
+    for (unsigned int i = 0; i < order.size(); i++) {
+        m_ChunkLayout.componentIds[i] = componentIds[order[i]];
+        m_ChunkLayout.componentSizes[i] = componentSizes[order[i]];
+        totalSize += componentSizes[order[i]];
+    }
     m_ChunkLayout.capacity = sizeof(Chunk) / totalSize;
 
     std::vector<std::pair<std::size_t, unsigned int>> alignAndIndices(componentIds.size() + 1);
-    for (unsigned int i = 0; i < componentAligns.size(); i++)
-        alignAndIndices[i] = {componentAligns[i], i};
+    for (unsigned int i = 0; i < order.size(); i++)
+        alignAndIndices[i] = {componentAligns[order[i]], i};
     alignAndIndices.back() = {alignof(Entity), -1};
     std::sort(alignAndIndices.begin(), alignAndIndices.end(), std::greater<>());
 
-    m_ChunkLayout.componentIndexMap.reserve(componentIds.size());
-    m_ChunkLayout.componentOffsets.resize(componentIds.size());
     std::size_t offset{};
     for (const auto& [align, index] : alignAndIndices) {
         if (index == -1) {
             m_ChunkLayout.entityOffset = offset;
             offset += sizeof(Entity) * m_ChunkLayout.capacity;
         } else {
-            m_ChunkLayout.componentIndexMap.emplace(componentIds[index], index);
             m_ChunkLayout.componentOffsets[index] = offset;
             offset += m_ChunkLayout.componentSizes[index] * m_ChunkLayout.capacity;
         }
@@ -55,6 +63,15 @@ void Archetype::addEntity(const Entity& entity, EntityLocation& location) {
         entityIndexInCombination};
 }
 
+void Archetype::addEntities(std::span<const Entity> entities, unsigned int& combinationIndex, unsigned int& firstEntityIndexInCombination) {
+    Combination* const combination = createCombination();
+    unsigned int chunkCountAdded;
+    combination->addEntities(entities, firstEntityIndexInCombination, chunkCountAdded);
+    m_ChunkCount += chunkCountAdded;
+    m_EntityCount += entities.size();
+    combinationIndex = combination->index();
+}
+
 void Archetype::moveEntityAddingComponent(const EntityLocation& srcEntityLocation, Archetype* srcArchetype, const unsigned int& componentId, const void* component, EntityLocation& dstLocation, Entity& srcSwappedEntity) {
     Combination* const srcCombination = srcArchetype->m_Combinations[srcEntityLocation.combinationIndex].get();
     std::vector<unsigned int> const& sharedComponentIndices = srcCombination->sharedComponentIndices();
@@ -159,6 +176,24 @@ void Archetype::moveEntityRemovingSharedComponent(const EntityLocation& srcEntit
     dstLocation = EntityLocation{m_Id, dstCombination->index(), entityIndexInDstCombination};
 }
 
+void Archetype::moveAllEntities(Archetype* srcArchetype, const unsigned int& componentId, const void* component, std::vector<EntityLocation>& entityLocations) {
+    std::vector<Entity> entities;
+    for (std::unique_ptr<Combination> const& srcCombination : srcArchetype->m_Combinations) {
+        if (srcCombination == nullptr) continue;
+        Combination* const dstCombination = createCombination(srcCombination->sharedComponentIndices());
+        unsigned int firstEntityIndexInCombination, chunkCountAdded, srcChunkCountMinused;
+        entities.clear();
+        dstCombination->moveAllEntities(srcCombination.get(), componentId, component, entities, firstEntityIndexInCombination, chunkCountAdded, srcChunkCountMinused);
+        for (unsigned int i = 0; i < entities.size(); i++)
+            entityLocations[entities[i].id] = EntityLocation{m_Id, dstCombination->index(), firstEntityIndexInCombination + i};
+        m_ChunkCount += chunkCountAdded;
+        m_EntityCount += entities.size();
+        srcArchetype->m_ChunkCount -= srcChunkCountMinused;
+        srcArchetype->m_EntityCount -= entities.size();
+        srcArchetype->destroyCombination(srcCombination.get());
+    }
+}
+
 void Archetype::removeEntity(const EntityLocation& location, std::vector<unsigned int>& sharedComponentIndices, Entity& swappedEntity) {
     // Need to copy SharedComponent indices because Combination may be destroyed
     sharedComponentIndices = m_Combinations[location.combinationIndex]->sharedComponentIndices();
@@ -173,6 +208,37 @@ void Archetype::removeEntity(const EntityLocation& location, std::vector<unsigne
     m_EntityCount--;
 }
 
+void Archetype::removeEntities(const unsigned int& combinationIndex, std::span<const unsigned int> entityIndicesInCombination, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount>& sharedComponentStore, std::vector<std::pair<Entity, unsigned int>>& movedEntities) {
+    Combination* combination = m_Combinations[combinationIndex].get();
+    std::vector<unsigned int> const& sharedComponentIndices = combination->sharedComponentIndices();
+    for (unsigned int i = 0; i < m_SharedComponentIds.size(); i++)
+        sharedComponentStore.pop(m_SharedComponentIds[i], sharedComponentIndices[i], entityIndicesInCombination.size());
+    m_EntityCount -= entityIndicesInCombination.size();
+    unsigned int chunkCountMinused;
+    combination->removeEntities(entityIndicesInCombination, movedEntities, chunkCountMinused);
+    m_ChunkCount -= chunkCountMinused;
+    if (combination->empty())
+        destroyCombination(combination);
+}
+
+void Archetype::removeCombination(const unsigned int& combinationIndex, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount>& sharedComponentStore, std::vector<Entity>& entities) {
+    Combination* combination = m_Combinations[combinationIndex].get();
+    std::vector<unsigned int> const& sharedComponentIndices = combination->sharedComponentIndices();
+    for (unsigned int i = 0; i < m_SharedComponentIds.size(); i++)
+        sharedComponentStore.pop(m_SharedComponentIds[i], sharedComponentIndices[i], combination->entityCount());
+    m_EntityCount -= combination->entityCount();
+    unsigned int chunkCountMinused;
+    combination->removeAllEntities(entities, chunkCountMinused);
+    m_ChunkCount -= chunkCountMinused;
+    destroyCombination(combination);
+}
+
+void Archetype::removeAllEntities(ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount>& sharedComponentStore, std::vector<Entity>& entities) {
+    for (std::unique_ptr<Combination> const& combination : m_Combinations)
+        if (combination != nullptr)
+            removeCombination(combination->index(), sharedComponentStore, entities);
+}
+
 void Archetype::setComponent(const EntityLocation& location, const unsigned int& componentId, const void* component) {
     m_Combinations[location.combinationIndex]->setComponent(location.entityIndexInCombination, componentId, component);
 }
@@ -203,9 +269,12 @@ void Archetype::setSharedComponent(const EntityLocation& location, const unsigne
 }
 
 void Archetype::filterEntities(const EntityFilter& entityFilter, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, std::vector<ChunkAccessor>& chunkAccessors) const {
+    std::vector<unsigned int> changedComponentIndices;
+    for (const unsigned int& componentId : entityFilter.changedComponentMask.ids())
+        changedComponentIndices.push_back(m_ChunkLayout.componentIndex(componentId));
     for (std::unique_ptr<Combination> const& combination : m_Combinations)
         if (combination != nullptr)
-            combination->filterEntities(sharedComponentStore, chunkAccessors);
+            combination->filterEntities(changedComponentIndices, entityFilter.changedSinceVersion, sharedComponentStore, chunkAccessors);
 }
 
 }  // namespace Melon
@@ -11,6 +11,7 @@
 
 #include <bitset>
 #include <memory>
+#include <span>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -47,10 +48,13 @@ class Archetype {
         std::vector<std::size_t> const& componentSizes,
         std::vector<std::size_t> const& componentAligns,
         std::vector<unsigned int> const& sharedComponentIds,
-        ObjectPool<Chunk>* chunkPool);
+        ObjectPool<Chunk>* chunkPool,
+        const unsigned int& version);
     Archetype(const Archetype&) = delete;
 
     void addEntity(const Entity& entity, EntityLocation& location);
+    // Add Entities to the default Combination, they take consecutive indices from the first one
+    void addEntities(std::span<const Entity> entities, unsigned int& combinationIndex, unsigned int& firstEntityIndexInCombination);
     // Move an Entity when adding a DataComponent
     void moveEntityAddingComponent(const EntityLocation& srcEntityLocation, Archetype* srcArchetype, const unsigned int& componentId, const void* component, EntityLocation& dstLocation, Entity& srcSwappedEntity);
     // Move an Entity when removing a DataComponent
@@ -59,7 +63,15 @@ class Archetype {
     void moveEntityAddingSharedComponent(const EntityLocation& srcEntityLocation, Archetype* srcArchetype, const unsigned int& sharedComponentId, const unsigned int& sharedComponentIndex, EntityLocation& dstLocation, Entity& srcSwappedEntity);
     // Move an Entity when removing a SharedComponent
     void moveEntityRemovingSharedComponent(const EntityLocation& srcEntityLocation, Archetype* srcArchetype, unsigned int& originalSharedComponentIndex, EntityLocation& dstLocation, Entity& srcSwappedEntity);
+    // Move all Entities of the source archetype when adding the component, or removing one if the component is null
+    // Their locations are updated in place
+    void moveAllEntities(Archetype* srcArchetype, const unsigned int& componentId, const void* component, std::vector<EntityLocation>& entityLocations);
     void removeEntity(const EntityLocation& location, std::vector<unsigned int>& sharedComponentIndices, Entity& swappedEntity);
+    // Remove Entities of a Combination at ascending indices, Entities moved to fill the holes are appended with their new indices
+    void removeEntities(const unsigned int& combinationIndex, std::span<const unsigned int> entityIndicesInCombination, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount>& sharedComponentStore, std::vector<std::pair<Entity, unsigned int>>& movedEntities);
+    // Remove all Entities of a Combination at once, references to its SharedComponents are released together
+    void removeCombination(const unsigned int& combinationIndex, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount>& sharedComponentStore, std::vector<Entity>& entities);
+    void removeAllEntities(ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount>& sharedComponentStore, std::vector<Entity>& entities);
     void setComponent(const EntityLocation& location, const unsigned int& componentId, const void* component);
     void setSharedComponent(const EntityLocation& location, const unsigned int& sharedComponentId, const unsigned int& sharedComponentIndex, unsigned int& originalSharedComponentIndex, EntityLocation& dstLocation, Entity& swappedEntity);
 
@@ -86,6 +98,7 @@ class Archetype {
 
     const unsigned int& chunkCount() const { return m_ChunkCount; }
     const unsigned int& entityCount() const { return m_EntityCount; }
+    const unsigned int& entityCount(const unsigned int& combinationIndex) const { return m_Combinations[combinationIndex]->entityCount(); }
 
   private:
     Combination* createCombination();
@@ -106,7 +119,14 @@ class Archetype {
     unsigned int m_ChunkCount{};
     unsigned int m_EntityCount{};
 
+    // Transitions to archetypes with one component added or removed, filled by EntityManager on first use
+    std::unordered_map<unsigned int, Archetype*> m_ComponentAddedArchetypes;
+    std::unordered_map<unsigned int, Archetype*> m_ComponentRemovedArchetypes;
+    std::unordered_map<unsigned int, Archetype*> m_SharedComponentAddedArchetypes;
+    std::unordered_map<unsigned int, Archetype*> m_SharedComponentRemovedArchetypes;
+
     ObjectPool<Chunk>* m_ChunkPool;
+    const unsigned int& m_Version;
     std::vector<std::unique_ptr<Combination>> m_Combinations;
     std::unordered_map<std::vector<unsigned int>, unsigned int, SharedComponentIndexHash> m_CombinationIndexMap;
     std::vector<unsigned int> m_FreeCombinationIndices;
@@ -140,10 +160,10 @@ inline Combination* Archetype::createCombination(std::vector<unsigned int> const
     unsigned int combinationIndex;
     if (m_FreeCombinationIndices.empty()) {
         combinationIndex = m_Combinations.size();
-        m_Combinations.emplace_back(std::make_unique<Combination>(combinationIndex, m_ChunkLayout, m_SharedComponentIds, sharedComponentIndices, m_ChunkPool));
+        m_Combinations.emplace_back(std::make_unique<Combination>(combinationIndex, m_ChunkLayout, m_SharedComponentIds, sharedComponentIndices, m_ChunkPool, m_Version));
     } else {
         combinationIndex = m_FreeCombinationIndices.back(), m_FreeCombinationIndices.pop_back();
-        m_Combinations[combinationIndex] = std::make_unique<Combination>(combinationIndex, m_ChunkLayout, m_SharedComponentIds, sharedComponentIndices, m_ChunkPool);
+        m_Combinations[combinationIndex] = std::make_unique<Combination>(combinationIndex, m_ChunkLayout, m_SharedComponentIds, sharedComponentIndices, m_ChunkPool, m_Version);
     }
     m_CombinationIndexMap.emplace(sharedComponentIndices, combinationIndex);
     return m_Combinations[combinationIndex].get();
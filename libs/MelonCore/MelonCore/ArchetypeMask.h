@@ -1,36 +1,60 @@
 #pragma once
 
-#include <bitset>
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 namespace Melon {
 
+// Set of component ids, cost of operations scales with the number of ids in it
+// Ids are kept in ascending order, and a 64 bits summary with bit (id % 64) set for each id rejects most mismatches in one word
+class ComponentIdSet {
+  public:
+    bool test(const unsigned int& id) const { return (m_Summary & summaryBit(id)) != 0 && std::binary_search(m_Ids.begin(), m_Ids.end(), id); }
+
+    // Returns true if the set is changed
+    bool set(const unsigned int& id, const bool& value = true);
+
+    // If all ids in other are also in this set
+    bool contains(const ComponentIdSet& other) const;
+    bool intersects(const ComponentIdSet& other) const;
+
+    bool any() const { return !m_Ids.empty(); }
+    bool none() const { return m_Ids.empty(); }
+    unsigned int count() const { return m_Ids.size(); }
+
+    std::vector<unsigned int> const& ids() const { return m_Ids; }
+
+    bool operator==(const ComponentIdSet& other) const { return m_Summary == other.m_Summary && m_Ids == other.m_Ids; }
+
+  private:
+    static std::uint64_t summaryBit(const unsigned int& id) { return std::uint64_t{1} << (id & 63U); }
+
+    std::vector<unsigned int> m_Ids;
+    std::uint64_t m_Summary{};
+};
+
 struct ArchetypeMask {
     static constexpr unsigned int k_MaxComponentIdCount = 1024U;
     static constexpr unsigned int k_MaxSharedComponentIdCount = 256U;
 
-    using ComponentMask = std::bitset<k_MaxComponentIdCount>;
-    using ManualComponentMask = std::bitset<k_MaxComponentIdCount>;
-    using SharedComponentMask = std::bitset<k_MaxSharedComponentIdCount>;
-    using ManualSharedComponentMask = std::bitset<k_MaxSharedComponentIdCount>;
+    using ComponentMask = ComponentIdSet;
+    using ManualComponentMask = ComponentIdSet;
+    using SharedComponentMask = ComponentIdSet;
+    using ManualSharedComponentMask = ComponentIdSet;
 
     struct Hash {
-        std::size_t operator()(const ArchetypeMask& mask) const {
-            return std::hash<ComponentMask>()(mask.componentMask) ^ std::hash<SharedComponentMask>()(mask.sharedComponentMask);
-        }
+        std::size_t operator()(const ArchetypeMask& mask) const { return mask.hash; }
     };
 
     ArchetypeMask() {}
 
     void markComponent(const unsigned int& componentId, const bool& manual, const bool& value = true) {
-        componentMask.set(componentId, value);
+        if (componentMask.set(componentId, value))
+            hash ^= mix(componentId);
         if (manual)
             manualComponentMask.set(componentId, value);
-        if (value)
-            count++;
-        else
-            count--;
     }
 
     void markComponents(std::vector<unsigned int> const& componentIds, std::vector<bool> const& manuals) {
@@ -39,13 +63,10 @@ struct ArchetypeMask {
     }
 
     void markSharedComponent(const unsigned int& sharedComponentId, const bool& manual, const bool& value = true) {
-        sharedComponentMask.set(sharedComponentId, value);
+        if (sharedComponentMask.set(sharedComponentId, value))
+            hash ^= mix(k_MaxComponentIdCount + sharedComponentId);
         if (manual)
             manualSharedComponentMask.set(sharedComponentId, value);
-        if (value)
-            count++;
-        else
-            count--;
     }
 
     void markSharedComponents(std::vector<unsigned int> const& sharedComponentIds, std::vector<bool> const& manuals) {
@@ -54,26 +75,78 @@ struct ArchetypeMask {
     }
 
     bool operator==(const ArchetypeMask& other) const {
-        return componentMask == other.componentMask && sharedComponentMask == other.sharedComponentMask;
+        return hash == other.hash && componentMask == other.componentMask && sharedComponentMask == other.sharedComponentMask;
     }
 
     bool manualComponent(const unsigned int& componentId) const { return manualComponentMask.test(componentId); }
     bool manualSharedComponent(const unsigned int& sharedComponentId) const { return manualSharedComponentMask.test(sharedComponentId); }
 
-    bool none() const { return count == 0; }
+    bool none() const { return componentMask.none() && sharedComponentMask.none(); }
 
-    bool single() const { return count == 1; }
+    bool single() const { return componentMask.count() + sharedComponentMask.count() == 1; }
     bool fullyManual() const { return !none() && componentMask == manualComponentMask && sharedComponentMask == manualSharedComponentMask; }
     bool partiallyManual() const { return !fullyManual() && (manualComponentMask.any() || manualSharedComponentMask.any()); }
 
     unsigned int componentCount() const { return componentMask.count(); }
     unsigned int sharedComponentCount() const { return sharedComponentMask.count(); }
 
-    unsigned int count{};
+    // Hash of each id is combined by xor so that marking could update it in place
+    static std::uint64_t mix(std::uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    std::uint64_t hash{};
     ComponentMask componentMask;
     ManualComponentMask manualComponentMask;
     SharedComponentMask sharedComponentMask;
     ManualSharedComponentMask manualSharedComponentMask;
 };
 
+inline bool ComponentIdSet::set(const unsigned int& id, const bool& value) {
+    const std::vector<unsigned int>::iterator it = std::lower_bound(m_Ids.begin(), m_Ids.end(), id);
+    const bool found = it != m_Ids.end() && *it == id;
+    if (found == value)
+        return false;
+    if (value)
+        m_Ids.insert(it, id);
+    else
+        m_Ids.erase(it);
+    // Other ids may share the summary bit
+    m_Summary = 0;
+    for (const unsigned int& i : m_Ids)
+        m_Summary |= summaryBit(i);
+    return true;
+}
+
+inline bool ComponentIdSet::contains(const ComponentIdSet& other) const {
+    if ((other.m_Summary & ~m_Summary) != 0 || other.m_Ids.size() > m_Ids.size())
+        return false;
+    unsigned int i = 0;
+    for (const unsigned int& id : other.m_Ids) {
+        while (i < m_Ids.size() && m_Ids[i] < id) i++;
+        if (i >= m_Ids.size() || m_Ids[i] != id)
+            return false;
+        i++;
+    }
+    return true;
+}
+
+inline bool ComponentIdSet::intersects(const ComponentIdSet& other) const {
+    if ((other.m_Summary & m_Summary) == 0)
+        return false;
+    unsigned int i = 0, j = 0;
+    while (i < m_Ids.size() && j < other.m_Ids.size()) {
+        if (m_Ids[i] < other.m_Ids[j])
+            i++;
+        else if (m_Ids[i] > other.m_Ids[j])
+            j++;
+        else
+            return true;
+    }
+    return false;
+}
+
 }  // namespace Melon
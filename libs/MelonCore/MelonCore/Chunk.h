@@ -2,18 +2,27 @@
 
 #include <MelonCore/Entity.h>
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdlib>
-#include <unordered_map>
+#include <limits>
 #include <vector>
 
 namespace Melon {
 
 struct ChunkLayout {
+    static constexpr unsigned int k_InvalidIndex = std::numeric_limits<unsigned int>::max();
+
+    // Index of the component in the arrays below, or k_InvalidIndex if absent
+    unsigned int componentIndex(const unsigned int& componentId) const;
+    // Whether the columns both layouts have are at the same place, so a chunk could change its layout without copying
+    bool columnsAligned(const ChunkLayout& other) const;
+
     unsigned int capacity;
     std::size_t entityOffset{};
-    std::unordered_map<unsigned int, unsigned int> componentIndexMap;
+    // Components are stored in ascending id order, so layouts could be matched by a linear merge
+    std::vector<unsigned int> componentIds;
     std::vector<std::size_t> componentSizes;
     std::vector<std::size_t> componentOffsets;
 };
@@ -28,4 +37,24 @@ struct Chunk {
     alignas(k_Align) std::array<std::byte, k_Size> memory;
 };
 
+inline unsigned int ChunkLayout::componentIndex(const unsigned int& componentId) const {
+    const auto it = std::lower_bound(componentIds.begin(), componentIds.end(), componentId);
+    if (it == componentIds.end() || *it != componentId)
+        return k_InvalidIndex;
+    return static_cast<unsigned int>(it - componentIds.begin());
+}
+
+inline bool ChunkLayout::columnsAligned(const ChunkLayout& other) const {
+    if (capacity != other.capacity || entityOffset != other.entityOffset)
+        return false;
+    for (unsigned int i = 0, j = 0; i < componentIds.size() && j < other.componentIds.size();)
+        if (componentIds[i] < other.componentIds[j])
+            i++;
+        else if (other.componentIds[j] < componentIds[i])
+            j++;
+        else if (componentOffsets[i++] != other.componentOffsets[j++])
+            return false;
+    return true;
+}
+
 }  // namespace Melon
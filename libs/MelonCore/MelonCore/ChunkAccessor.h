@@ -7,13 +7,20 @@
 #include <MelonCore/ObjectStore.h>
 #include <MelonCore/SharedComponent.h>
 
+#include <atomic>
+#include <cassert>
+#include <type_traits>
+
 namespace Melon {
 
 class ChunkAccessor {
   public:
     const Entity* entityArray() const;
+    // The component of the chunk is marked as changed unless Type is const
     template <typename Type>
     Type* componentArray(const unsigned int& componentId) const;
+    // Version of the EntityManager when the component of the chunk was last written
+    unsigned int componentVersion(const unsigned int& componentId) const;
 
     unsigned int sharedComponentIndex(const unsigned int& sharedComponentId) const;
     template <typename Type>
@@ -22,7 +29,7 @@ class ChunkAccessor {
     const unsigned int& entityCount() const { return m_EntityCount; }
 
   private:
-    ChunkAccessor(std::byte* chunk, const ChunkLayout& chunkLayout, const unsigned int& entityCount, std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore);
+    ChunkAccessor(std::byte* chunk, const ChunkLayout& chunkLayout, const unsigned int& entityCount, std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, unsigned int* componentVersions, const unsigned int& version);
     std::byte* const m_Chunk;
     const ChunkLayout& m_ChunkLayout;
     const unsigned int& m_EntityCount;
@@ -31,6 +38,10 @@ class ChunkAccessor {
 
     ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& m_SharedComponentStore;
 
+    unsigned int* const m_ComponentVersions;
+    // Version of the EntityManager when the chunk is filtered, tasks may run after it is increased
+    const unsigned int m_Version;
+
     friend class Combination;
 };
 
@@ -41,7 +52,18 @@ inline const Entity* ChunkAccessor::entityArray() const {
 template <typename Type>
 inline Type* ChunkAccessor::componentArray(const unsigned int& componentId) const {
     static_assert(std::is_base_of_v<DataComponent, Type>);
-    return reinterpret_cast<Type*>(reinterpret_cast<std::byte*>(m_Chunk) + m_ChunkLayout.componentOffsets[m_ChunkLayout.componentIndexMap.at(componentId)]);
+    const unsigned int componentIndex = m_ChunkLayout.componentIndex(componentId);
+    assert(componentIndex != ChunkLayout::k_InvalidIndex);
+    // Versions are stamped by tasks while others may filter or read them, relaxed order is enough since only the value is used
+    if constexpr (!std::is_const_v<Type>)
+        std::atomic_ref<unsigned int>(m_ComponentVersions[componentIndex]).store(m_Version, std::memory_order_relaxed);
+    return reinterpret_cast<Type*>(reinterpret_cast<std::byte*>(m_Chunk) + m_ChunkLayout.componentOffsets[componentIndex]);
+}
+
+inline unsigned int ChunkAccessor::componentVersion(const unsigned int& componentId) const {
+    const unsigned int componentIndex = m_ChunkLayout.componentIndex(componentId);
+    assert(componentIndex != ChunkLayout::k_InvalidIndex);
+    return std::atomic_ref<unsigned int>(m_ComponentVersions[componentIndex]).load(std::memory_order_relaxed);
 }
 
 inline unsigned int ChunkAccessor::sharedComponentIndex(const unsigned int& sharedComponentId) const {
@@ -57,6 +79,6 @@ inline const Type* ChunkAccessor::sharedComponent(const unsigned int& sharedComp
     return m_SharedComponentStore.object<Type>(sharedComponentIndex(sharedComponentId));
 }
 
-inline ChunkAccessor::ChunkAccessor(std::byte* chunk, const ChunkLayout& chunkLayout, const unsigned int& entityCount, std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore) : m_Chunk(chunk), m_ChunkLayout(chunkLayout), m_EntityCount(entityCount), m_SharedComponentIds(sharedComponentIds), m_SharedComponentIndices(sharedComponentIndices), m_SharedComponentStore(sharedComponentStore) {}
+inline ChunkAccessor::ChunkAccessor(std::byte* chunk, const ChunkLayout& chunkLayout, const unsigned int& entityCount, std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, unsigned int* componentVersions, const unsigned int& version) : m_Chunk(chunk), m_ChunkLayout(chunkLayout), m_EntityCount(entityCount), m_SharedComponentIds(sharedComponentIds), m_SharedComponentIndices(sharedComponentIndices), m_SharedComponentStore(sharedComponentStore), m_ComponentVersions(componentVersions), m_Version(version) {}
 
 }  // namespace Melon
@@ -1,6 +1,7 @@
 #include <MelonCore/Combination.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <functional>
 
@@ -11,12 +12,14 @@ Combination::Combination(
     const ChunkLayout& chunkLayout,
     std::vector<unsigned int> const& sharedComponentIds,
     std::vector<unsigned int> const& sharedComponentIndices,
-    ObjectPool<Chunk>* chunkPool)
+    ObjectPool<Chunk>* chunkPool,
+    const unsigned int& version)
     : m_Index(index),
       m_ChunkLayout(chunkLayout),
       m_SharedComponentIds(sharedComponentIds),
       m_SharedComponentIndices(sharedComponentIndices),
       m_ChunkPool(chunkPool),
+      m_Version(version),
       m_EntityCountInCurrentChunk(chunkLayout.capacity) {
 }
 
@@ -25,11 +28,29 @@ void Combination::addEntity(const Entity& entity, unsigned int& entityIndexInCom
     if (chunkCountAdded)
         requestChunk();
     Chunk* chunk = m_Chunks.back();
+    markChunkChanged(m_Chunks.size() - 1);
     unsigned int entityIndexInChunk = m_EntityCountInCurrentChunk++;
     memcpy(entityAddress(chunk, entityIndexInChunk), &entity, sizeof(Entity));
     entityIndexInCombination = m_EntityCount++;
 }
 
+void Combination::addEntities(std::span<const Entity> entities, unsigned int& firstEntityIndexInCombination, unsigned int& chunkCountAdded) {
+    firstEntityIndexInCombination = m_EntityCount;
+    chunkCountAdded = 0;
+    for (std::size_t added = 0; added < entities.size();) {
+        if (m_EntityCountInCurrentChunk == m_ChunkLayout.capacity) {
+            requestChunk();
+            chunkCountAdded++;
+        }
+        const unsigned int count = std::min<std::size_t>(entities.size() - added, m_ChunkLayout.capacity - m_EntityCountInCurrentChunk);
+        markChunkChanged(m_Chunks.size() - 1);
+        memcpy(entityAddress(m_Chunks.back(), m_EntityCountInCurrentChunk), entities.data() + added, sizeof(Entity) * count);
+        m_EntityCountInCurrentChunk += count;
+        m_EntityCount += count;
+        added += count;
+    }
+}
+
 void Combination::moveEntityAddingComponent(const unsigned int& entityIndexInSrcCombination, Combination* srcCombination, const unsigned int& componentId, const void* component, unsigned int& entityIndexInDstCombination, bool& dstChunkCountAdded, Entity& swappedEntity, bool& srcChunkCountMinused) {
     const Entity& srcEntity = *srcCombination->entityAddress(entityIndexInSrcCombination);
     addEntity(srcEntity, entityIndexInDstCombination, dstChunkCountAdded);
@@ -37,13 +58,7 @@ void Combination::moveEntityAddingComponent(const unsigned int& entityIndexInSrc
     Chunk* dstChunk = m_Chunks.back();
     unsigned int entityIndexInDstChunk = m_EntityCountInCurrentChunk - 1;
 
-    for (const auto& [id, index] : m_ChunkLayout.componentIndexMap) {
-        if (id == componentId) continue;
-        const std::size_t& size = m_ChunkLayout.componentSizes[index];
-        void* dstAddress = componentAddress(dstChunk, index, entityIndexInDstChunk);
-        void* srcAddress = srcCombination->componentAddress(id, entityIndexInSrcCombination);
-        memcpy(dstAddress, srcAddress, size);
-    }
+    copyComponents(dstChunk, entityIndexInDstChunk, srcCombination, entityIndexInSrcCombination);
 
     setComponent(entityIndexInDstCombination, componentId, component);
 
@@ -57,12 +72,7 @@ void Combination::moveEntityRemovingComponent(const unsigned int& entityIndexInS
     Chunk* dstChunk = m_Chunks.back();
     unsigned int entityIndexInDstChunk = m_EntityCountInCurrentChunk - 1;
 
-    for (const auto& [id, index] : m_ChunkLayout.componentIndexMap) {
-        const std::size_t& size = m_ChunkLayout.componentSizes[index];
-        void* dstAddress = componentAddress(dstChunk, index, entityIndexInDstChunk);
-        void* srcAddress = srcCombination->componentAddress(id, entityIndexInSrcCombination);
-        memcpy(dstAddress, srcAddress, size);
-    }
+    copyComponents(dstChunk, entityIndexInDstChunk, srcCombination, entityIndexInSrcCombination);
 
     srcCombination->removeEntity(entityIndexInSrcCombination, swappedEntity, srcChunkCountMinused);
 }
@@ -74,18 +84,21 @@ void Combination::removeEntity(const unsigned int& entityIndexInCombination, Ent
     Chunk* srcChunk = m_Chunks.back();
     const unsigned int srcEntityIndexInChunk = m_EntityCountInCurrentChunk - 1;
 
-    for (const auto& [id, index] : m_ChunkLayout.componentIndexMap) {
-        const std::size_t& size = m_ChunkLayout.componentSizes[index];
-        void* dstAddress = componentAddress(dstChunk, index, dstEntityIndexInChunk);
-        void* srcAddress = componentAddress(srcChunk, index, srcEntityIndexInChunk);
-        if (dstChunk != srcChunk || dstEntityIndexInChunk != srcEntityIndexInChunk)
+    const bool swapped = dstChunk != srcChunk || dstEntityIndexInChunk != srcEntityIndexInChunk;
+    if (swapped)
+        markChunkChanged(entityIndexInCombination / m_ChunkLayout.capacity);
+    for (unsigned int i = 0; i < m_ChunkLayout.componentSizes.size(); i++) {
+        const std::size_t size = m_ChunkLayout.componentSizes[i];
+        void* dstAddress = componentAddress(dstChunk, i, dstEntityIndexInChunk);
+        void* srcAddress = componentAddress(srcChunk, i, srcEntityIndexInChunk);
+        if (swapped)
             memcpy(dstAddress, srcAddress, size);
         memset(srcAddress, 0, size);
     }
 
     void* dstEntityAddress = static_cast<void*>(entityAddress(dstChunk, dstEntityIndexInChunk));
     void* srcEntityAddress = static_cast<void*>(entityAddress(srcChunk, srcEntityIndexInChunk));
-    if (dstChunk != srcChunk || dstEntityIndexInChunk != srcEntityIndexInChunk)
+    if (swapped)
         memcpy(dstEntityAddress, srcEntityAddress, sizeof(Entity));
     memset(srcEntityAddress, 0, sizeof(Entity));
 
@@ -95,29 +108,189 @@ void Combination::removeEntity(const unsigned int& entityIndexInCombination, Ent
     chunkCountMinused = m_EntityCountInCurrentChunk == 0;
     if (chunkCountMinused) recycleChunk();
 
-    if (dstChunk != srcChunk || dstEntityIndexInChunk != srcEntityIndexInChunk)
+    if (swapped)
         swappedEntity = *static_cast<Entity*>(dstEntityAddress);
     else
         swappedEntity = Entity::invalidEntity();
 }
 
+void Combination::removeEntities(std::span<const unsigned int> entityIndicesInCombination, std::vector<std::pair<Entity, unsigned int>>& movedEntities, unsigned int& chunkCountMinused) {
+    chunkCountMinused = 0;
+    // Handle the greatest pending indices first, so Entities at the tail are never pending unless they are removed directly
+    for (std::size_t pendingCount = entityIndicesInCombination.size(); pendingCount > 0;) {
+        const unsigned int last = entityIndicesInCombination[pendingCount - 1];
+        Chunk* tailChunk = m_Chunks.back();
+        unsigned int count = 1;
+        if (last == m_EntityCount - 1) {
+            // Drop a run of pending Entities at the tail
+            while (count < m_EntityCountInCurrentChunk && count < pendingCount && entityIndicesInCombination[pendingCount - 1 - count] == last - count)
+                count++;
+            const unsigned int first = m_EntityCountInCurrentChunk - count;
+            for (unsigned int i = 0; i < m_ChunkLayout.componentSizes.size(); i++)
+                memset(componentAddress(tailChunk, i, first), 0, m_ChunkLayout.componentSizes[i] * count);
+            memset(entityAddress(tailChunk, first), 0, sizeof(Entity) * count);
+        } else {
+            // Fill a run of holes in one chunk with the same count of Entities at the tail
+            const unsigned int lastIndexInChunk = last % m_ChunkLayout.capacity;
+            const unsigned int maxCount = std::min(m_EntityCountInCurrentChunk, m_EntityCount - 1 - last);
+            while (count < maxCount && count <= lastIndexInChunk && count < pendingCount && entityIndicesInCombination[pendingCount - 1 - count] == last - count)
+                count++;
+            Chunk* holeChunk = m_Chunks[last / m_ChunkLayout.capacity];
+            markChunkChanged(last / m_ChunkLayout.capacity);
+            const unsigned int dstFirst = lastIndexInChunk + 1 - count;
+            const unsigned int srcFirst = m_EntityCountInCurrentChunk - count;
+            for (unsigned int i = 0; i < m_ChunkLayout.componentSizes.size(); i++) {
+                void* srcAddress = componentAddress(tailChunk, i, srcFirst);
+                memcpy(componentAddress(holeChunk, i, dstFirst), srcAddress, m_ChunkLayout.componentSizes[i] * count);
+                memset(srcAddress, 0, m_ChunkLayout.componentSizes[i] * count);
+            }
+            Entity* srcEntities = entityAddress(tailChunk, srcFirst);
+            memcpy(entityAddress(holeChunk, dstFirst), srcEntities, sizeof(Entity) * count);
+            for (unsigned int i = 0; i < count; i++)
+                movedEntities.emplace_back(srcEntities[i], last + 1 - count + i);
+            memset(srcEntities, 0, sizeof(Entity) * count);
+        }
+        pendingCount -= count;
+        m_EntityCountInCurrentChunk -= count;
+        m_EntityCount -= count;
+        if (m_EntityCountInCurrentChunk == 0) {
+            recycleChunk();
+            chunkCountMinused++;
+        }
+    }
+}
+
+void Combination::moveAllEntities(Combination* srcCombination, const unsigned int& componentId, const void* component, std::vector<Entity>& entities, unsigned int& firstEntityIndexInCombination, unsigned int& chunkCountAdded, unsigned int& srcChunkCountMinused) {
+    const ChunkLayout& srcLayout = srcCombination->m_ChunkLayout;
+    const unsigned int componentIndex = component != nullptr ? m_ChunkLayout.componentIndex(componentId) : ChunkLayout::k_InvalidIndex;
+    firstEntityIndexInCombination = m_EntityCount;
+    chunkCountAdded = 0;
+    srcChunkCountMinused = srcCombination->m_Chunks.size();
+    entities.reserve(entities.size() + srcCombination->m_EntityCount);
+
+    if (empty() && m_ChunkLayout.columnsAligned(srcLayout)) {
+        // Relabel the chunks, only the added column is filled and the removed columns are zeroed
+        for (Chunk* chunk : srcCombination->m_Chunks) {
+            const unsigned int entityCountInChunk = chunk != srcCombination->m_Chunks.back() ? srcLayout.capacity : srcCombination->m_EntityCountInCurrentChunk;
+            const Entity* chunkEntities = entityAddress(chunk, 0);
+            entities.insert(entities.end(), chunkEntities, chunkEntities + entityCountInChunk);
+            if (componentIndex != ChunkLayout::k_InvalidIndex)
+                fillComponent(chunk, componentIndex, 0, entityCountInChunk, component);
+            for (unsigned int i = 0; i < srcLayout.componentIds.size(); i++)
+                if (m_ChunkLayout.componentIndex(srcLayout.componentIds[i]) == ChunkLayout::k_InvalidIndex)
+                    memset(reinterpret_cast<std::byte*>(chunk) + srcLayout.componentOffsets[i], 0, srcLayout.componentSizes[i] * entityCountInChunk);
+        }
+        m_Chunks = std::move(srcCombination->m_Chunks);
+        // Component indices differ between the layouts, so the versions start over
+        m_ComponentVersions.resize(m_Chunks.size());
+        for (unsigned int i = 0; i < m_Chunks.size(); i++) {
+            m_ComponentVersions[i] = std::make_unique<unsigned int[]>(m_ChunkLayout.componentIds.size());
+            markChunkChanged(i);
+        }
+        m_EntityCount = srcCombination->m_EntityCount;
+        m_EntityCountInCurrentChunk = srcCombination->m_EntityCountInCurrentChunk;
+        chunkCountAdded = m_Chunks.size();
+    } else {
+        for (Chunk* srcChunk : srcCombination->m_Chunks) {
+            const unsigned int srcEntityCountInChunk = srcChunk != srcCombination->m_Chunks.back() ? srcLayout.capacity : srcCombination->m_EntityCountInCurrentChunk;
+            for (unsigned int srcFirst = 0; srcFirst < srcEntityCountInChunk;) {
+                if (m_EntityCountInCurrentChunk == m_ChunkLayout.capacity) {
+                    requestChunk();
+                    chunkCountAdded++;
+                }
+                Chunk* dstChunk = m_Chunks.back();
+                markChunkChanged(m_Chunks.size() - 1);
+                const unsigned int count = std::min(srcEntityCountInChunk - srcFirst, m_ChunkLayout.capacity - m_EntityCountInCurrentChunk);
+                copyComponents(dstChunk, m_EntityCountInCurrentChunk, srcLayout, srcChunk, srcFirst, count);
+                if (componentIndex != ChunkLayout::k_InvalidIndex)
+                    fillComponent(dstChunk, componentIndex, m_EntityCountInCurrentChunk, count, component);
+                memcpy(entityAddress(dstChunk, m_EntityCountInCurrentChunk), srcCombination->entityAddress(srcChunk, srcFirst), sizeof(Entity) * count);
+                m_EntityCountInCurrentChunk += count;
+                m_EntityCount += count;
+                srcFirst += count;
+            }
+            const Entity* chunkEntities = srcCombination->entityAddress(srcChunk, 0);
+            entities.insert(entities.end(), chunkEntities, chunkEntities + srcEntityCountInChunk);
+            memset(srcChunk->memory.data(), 0, srcChunk->memory.size());
+            m_ChunkPool->recycle(srcChunk);
+        }
+    }
+    srcCombination->m_Chunks.clear();
+    srcCombination->m_ComponentVersions.clear();
+    srcCombination->m_EntityCount = 0;
+    srcCombination->m_EntityCountInCurrentChunk = srcLayout.capacity;
+}
+
+void Combination::removeAllEntities(std::vector<Entity>& entities, unsigned int& chunkCountMinused) {
+    entities.reserve(entities.size() + m_EntityCount);
+    for (Chunk* chunk : m_Chunks) {
+        const unsigned int entityCountInChunk = chunk != m_Chunks.back() ? m_ChunkLayout.capacity : m_EntityCountInCurrentChunk;
+        const Entity* chunkEntities = entityAddress(chunk, 0);
+        entities.insert(entities.end(), chunkEntities, chunkEntities + entityCountInChunk);
+        // Chunks are expected to be zeroed when requested
+        memset(chunk->memory.data(), 0, chunk->memory.size());
+        m_ChunkPool->recycle(chunk);
+    }
+    chunkCountMinused = m_Chunks.size();
+    m_Chunks.clear();
+    m_ComponentVersions.clear();
+    m_EntityCount = 0;
+    m_EntityCountInCurrentChunk = m_ChunkLayout.capacity;
+}
+
 void Combination::setComponent(const unsigned int& entityIndexInCombination, const unsigned int& componentId, const void* component) {
     Chunk* chunk = m_Chunks[entityIndexInCombination / m_ChunkLayout.capacity];
     const unsigned int entityIndexInChunk = entityIndexInCombination % m_ChunkLayout.capacity;
-    const unsigned int componentIndex = m_ChunkLayout.componentIndexMap.at(componentId);
+    const unsigned int componentIndex = m_ChunkLayout.componentIndex(componentId);
+    assert(componentIndex != ChunkLayout::k_InvalidIndex);
     void* address = componentAddress(chunk, componentIndex, entityIndexInChunk);
 
     memcpy(address, component, m_ChunkLayout.componentSizes[componentIndex]);
+    std::atomic_ref<unsigned int>(m_ComponentVersions[entityIndexInCombination / m_ChunkLayout.capacity][componentIndex]).store(m_Version, std::memory_order_relaxed);
+}
+
+void Combination::copyComponents(Chunk* dstChunk, const unsigned int& entityIndexInDstChunk, const Combination* srcCombination, const unsigned int& entityIndexInSrcCombination) const {
+    const ChunkLayout& srcLayout = srcCombination->m_ChunkLayout;
+    Chunk* srcChunk = srcCombination->m_Chunks[entityIndexInSrcCombination / srcLayout.capacity];
+    copyComponents(dstChunk, entityIndexInDstChunk, srcLayout, srcChunk, entityIndexInSrcCombination % srcLayout.capacity, 1);
+}
+
+void Combination::copyComponents(Chunk* dstChunk, const unsigned int& entityIndexInDstChunk, const ChunkLayout& srcLayout, Chunk* srcChunk, const unsigned int& entityIndexInSrcChunk, const unsigned int& count) const {
+    // Both id arrays are ascending, walk them together
+    unsigned int dstIndex = 0, srcIndex = 0;
+    while (dstIndex < m_ChunkLayout.componentIds.size() && srcIndex < srcLayout.componentIds.size()) {
+        const unsigned int& dstId = m_ChunkLayout.componentIds[dstIndex];
+        const unsigned int& srcId = srcLayout.componentIds[srcIndex];
+        if (dstId < srcId)
+            dstIndex++;
+        else if (srcId < dstId)
+            srcIndex++;
+        else {
+            const std::size_t& size = m_ChunkLayout.componentSizes[dstIndex];
+            memcpy(componentAddress(dstChunk, dstIndex, entityIndexInDstChunk), reinterpret_cast<std::byte*>(srcChunk) + srcLayout.componentOffsets[srcIndex] + size * entityIndexInSrcChunk, size * count);
+            dstIndex++, srcIndex++;
+        }
+    }
+}
+
+void Combination::fillComponent(Chunk* chunk, const unsigned int& componentIndex, const unsigned int& entityIndexInChunk, const unsigned int& count, const void* component) const {
+    const std::size_t& size = m_ChunkLayout.componentSizes[componentIndex];
+    std::byte* address = static_cast<std::byte*>(componentAddress(chunk, componentIndex, entityIndexInChunk));
+    for (unsigned int i = 0; i < count; i++, address += size)
+        memcpy(address, component, size);
 }
 
 void Combination::requestChunk() {
     m_Chunks.emplace_back(m_ChunkPool->request());
+    m_ComponentVersions.emplace_back(std::make_unique<unsigned int[]>(m_ChunkLayout.componentIds.size()));
+    markChunkChanged(m_Chunks.size() - 1);
     m_EntityCountInCurrentChunk = 0;
 }
 
 void Combination::recycleChunk() {
     Chunk* chunk = m_Chunks.back();
     m_Chunks.pop_back();
+    m_ComponentVersions.pop_back();
     m_ChunkPool->recycle(chunk);
     m_EntityCountInCurrentChunk = m_ChunkLayout.capacity;
 }
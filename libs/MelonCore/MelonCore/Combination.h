@@ -7,10 +7,15 @@
 #include <MelonCore/ObjectPool.h>
 #include <MelonCore/ObjectStore.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <climits>
 #include <cstddef>
 #include <cstdlib>
-#include <unordered_map>
+#include <memory>
+#include <span>
+#include <utility>
 #include <vector>
 
 namespace Melon {
@@ -20,22 +25,32 @@ class Combination {
     static constexpr unsigned int k_InvalidIndex = std::numeric_limits<unsigned int>::max();
     static constexpr unsigned int k_InvalidEntityIndex = std::numeric_limits<unsigned int>::max();
 
-    Combination(const unsigned int& index, const ChunkLayout& chunkLayout, std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices, ObjectPool<Chunk>* chunkPool);
+    Combination(const unsigned int& index, const ChunkLayout& chunkLayout, std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices, ObjectPool<Chunk>* chunkPool, const unsigned int& version);
     Combination(const Combination&) = delete;
 
     void addEntity(const Entity& entity, unsigned int& entityIndexInCombination, bool& chunkCountAdded);
+    // Add Entities by filling whole ranges of chunks
+    void addEntities(std::span<const Entity> entities, unsigned int& firstEntityIndexInCombination, unsigned int& chunkCountAdded);
     // Move an Entity when adding one component
     void moveEntityAddingComponent(const unsigned int& entityIndexInSrcCombination, Combination* srcCombination, const unsigned int& componentId, const void* component, unsigned int& entityIndexInDstCombination, bool& dstChunkCountAdded, Entity& swappedEntity, bool& srcChunkCountMinused);
     // Move an Entity when removing zero or more components
     void moveEntityRemovingComponent(const unsigned int& entityIndexInSrcCombination, Combination* srcCombination, unsigned int& entityIndexInDstCombination, bool& dstChunkCountAdded, Entity& swappedEntity, bool& srcChunkCountMinused);
     void removeEntity(const unsigned int& entityIndexInCombination, Entity& swappedEntity, bool& chunkCountMinused);
+    // Remove Entities at ascending indices, holes are filled by ranges of Entities from the tail and emptied chunks are recycled
+    void removeEntities(std::span<const unsigned int> entityIndicesInCombination, std::vector<std::pair<Entity, unsigned int>>& movedEntities, unsigned int& chunkCountMinused);
+    // Move all Entities of the source Combination by whole column ranges, or take its chunks over if the layouts are aligned
+    // The component is added with the value if it is not null, Entities moved are appended in their new order from the first index
+    void moveAllEntities(Combination* srcCombination, const unsigned int& componentId, const void* component, std::vector<Entity>& entities, unsigned int& firstEntityIndexInCombination, unsigned int& chunkCountAdded, unsigned int& srcChunkCountMinused);
+    // Remove all Entities and recycle whole chunks, the removed Entities are appended
+    void removeAllEntities(std::vector<Entity>& entities, unsigned int& chunkCountMinused);
     void setComponent(const unsigned int& entityIndexInCombination, const unsigned int& componentId, const void* component);
 
-    void filterEntities(ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, std::vector<ChunkAccessor>& chunkAccessors) const;
+    // Chunks are skipped unless one of the components at the indices is written in or after the version, no indices means all chunks
+    void filterEntities(std::vector<unsigned int> const& changedComponentIndices, const unsigned int& changedSinceVersion, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, std::vector<ChunkAccessor>& chunkAccessors) const;
 
     bool empty() const { return m_EntityCount == 0; }
     unsigned int chunkCount() const { return m_Chunks.size(); }
-    bool hasComponent(const unsigned int& componentId) const { return m_ChunkLayout.componentIndexMap.contains(componentId); }
+    bool hasComponent(const unsigned int& componentId) const { return m_ChunkLayout.componentIndex(componentId) != ChunkLayout::k_InvalidIndex; }
 
     const unsigned int& index() const { return m_Index; }
 
@@ -45,6 +60,13 @@ class Combination {
   private:
     void requestChunk();
     void recycleChunk();
+    // Entities of the chunk are added, moved or overwritten, so all its components are changed
+    void markChunkChanged(const unsigned int& chunkIndex);
+
+    // Copy the components both layouts have from an Entity in the source Combination
+    void copyComponents(Chunk* dstChunk, const unsigned int& entityIndexInDstChunk, const Combination* srcCombination, const unsigned int& entityIndexInSrcCombination) const;
+    void copyComponents(Chunk* dstChunk, const unsigned int& entityIndexInDstChunk, const ChunkLayout& srcLayout, Chunk* srcChunk, const unsigned int& entityIndexInSrcChunk, const unsigned int& count) const;
+    void fillComponent(Chunk* chunk, const unsigned int& componentIndex, const unsigned int& entityIndexInChunk, const unsigned int& count, const void* component) const;
 
     Entity* entityAddress(const unsigned int& entityIndex) const;
     Entity* entityAddress(Chunk* chunk, const unsigned int& entityIndexInChunk) const;
@@ -60,15 +82,27 @@ class Combination {
 
     ObjectPool<Chunk>* m_ChunkPool;
     std::vector<Chunk*> m_Chunks;
+    // Version of the EntityManager when each component of each chunk was last written, in the order of m_Chunks
+    std::vector<std::unique_ptr<unsigned int[]>> m_ComponentVersions;
+    const unsigned int& m_Version;
 
     unsigned int m_EntityCount{};
     unsigned int m_EntityCountInCurrentChunk{};
 };
 
-inline void Combination::filterEntities(ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, std::vector<ChunkAccessor>& chunkAccessors) const {
+inline void Combination::filterEntities(std::vector<unsigned int> const& changedComponentIndices, const unsigned int& changedSinceVersion, ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> const& sharedComponentStore, std::vector<ChunkAccessor>& chunkAccessors) const {
     chunkAccessors.reserve(chunkAccessors.size() + chunkCount());
-    for (Chunk* chunk : m_Chunks)
-        chunkAccessors.emplace_back(ChunkAccessor{reinterpret_cast<std::byte*>(chunk), m_ChunkLayout, chunk != m_Chunks.back() ? m_ChunkLayout.capacity : m_EntityCountInCurrentChunk, m_SharedComponentIds, m_SharedComponentIndices, sharedComponentStore});
+    for (unsigned int i = 0; i < m_Chunks.size(); i++) {
+        unsigned int* componentVersions = m_ComponentVersions[i].get();
+        if (!changedComponentIndices.empty() && std::none_of(changedComponentIndices.begin(), changedComponentIndices.end(), [componentVersions, &changedSinceVersion](const unsigned int& componentIndex) { return std::atomic_ref<unsigned int>(componentVersions[componentIndex]).load(std::memory_order_relaxed) >= changedSinceVersion; }))
+            continue;
+        chunkAccessors.emplace_back(ChunkAccessor{reinterpret_cast<std::byte*>(m_Chunks[i]), m_ChunkLayout, i != m_Chunks.size() - 1 ? m_ChunkLayout.capacity : m_EntityCountInCurrentChunk, m_SharedComponentIds, m_SharedComponentIndices, sharedComponentStore, componentVersions, m_Version});
+    }
+}
+
+inline void Combination::markChunkChanged(const unsigned int& chunkIndex) {
+    for (unsigned int i = 0; i < m_ChunkLayout.componentIds.size(); i++)
+        std::atomic_ref<unsigned int>(m_ComponentVersions[chunkIndex][i]).store(m_Version, std::memory_order_relaxed);
 }
 
 inline Entity* Combination::entityAddress(const unsigned int& entityIndex) const {
@@ -84,7 +118,8 @@ inline Entity* Combination::entityAddress(Chunk* chunk, const unsigned int& enti
 inline void* Combination::componentAddress(const unsigned int& componentId, const unsigned int& entityIndex) const {
     Chunk* chunk = m_Chunks[entityIndex / m_ChunkLayout.capacity];
     const unsigned int entityIndexInChunk = entityIndex % m_ChunkLayout.capacity;
-    const unsigned int componentIndex = m_ChunkLayout.componentIndexMap.at(componentId);
+    const unsigned int componentIndex = m_ChunkLayout.componentIndex(componentId);
+    assert(componentIndex != ChunkLayout::k_InvalidIndex);
     return componentAddress(chunk, componentIndex, entityIndexInChunk);
 }
 
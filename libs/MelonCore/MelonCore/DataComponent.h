@@ -1,9 +1,18 @@
 #pragma once
 
+#include <cstddef>
+#include <type_traits>
+
 namespace Melon {
 
 struct DataComponent {};
 
 struct ManualDataComponent : public DataComponent {};
 
+// Size of a DataComponent in chunks, tags without data take no space so adding or removing them could keep the chunk layout
+template <typename Type>
+constexpr std::size_t componentSize() {
+    return std::is_empty_v<Type> ? 0 : sizeof(Type);
+}
+
 }  // namespace Melon
@@ -2,7 +2,6 @@
 
 #include <MelonCore/ArchetypeMask.h>
 
-#include <bitset>
 #include <vector>
 
 namespace Melon {
@@ -18,6 +17,10 @@ struct EntityFilter {
     ArchetypeMask::SharedComponentMask requiredSharedComponentMask;
     ArchetypeMask::SharedComponentMask rejectedSharedComponentMask;
 
+    // Only chunks with one of these components written in or after the version are filtered, they are required as well
+    ArchetypeMask::ComponentMask changedComponentMask;
+    unsigned int changedSinceVersion{};
+
     // FIXME: It will crash if SharedComponents are destroyed
     // SharedComponents should be in ascending order
     std::vector<std::pair<unsigned int, unsigned int>> requiredSharedComponentIdAndIndices;
@@ -26,9 +29,7 @@ struct EntityFilter {
 };
 
 inline bool EntityFilter::satisfied(const ArchetypeMask& mask) const {
-    const bool requiredSatisfied = (mask.componentMask | requiredComponentMask) == mask.componentMask && (mask.sharedComponentMask | requiredSharedComponentMask) == mask.sharedComponentMask;
-    const bool rejectedSatisfied = (mask.componentMask & rejectedComponentMask).none() && (mask.sharedComponentMask & rejectedSharedComponentMask).none();
-    return requiredSatisfied && rejectedSatisfied;
+    return mask.componentMask.contains(requiredComponentMask) && mask.componentMask.contains(changedComponentMask) && mask.sharedComponentMask.contains(requiredSharedComponentMask) && !mask.componentMask.intersects(rejectedComponentMask) && !mask.sharedComponentMask.intersects(rejectedSharedComponentMask);
 }
 
 inline bool EntityFilter::satisfied(std::vector<unsigned int> const& sharedComponentIds, std::vector<unsigned int> const& sharedComponentIndices) const {
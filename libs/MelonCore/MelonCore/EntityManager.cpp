@@ -1,7 +1,5 @@
 #include <MelonCore/EntityManager.h>
 
-#include <typeindex>
-
 namespace Melon {
 
 EntityCommandBuffer::EntityCommandBuffer(EntityManager* entityManager) noexcept : m_EntityManager(entityManager) {}
@@ -22,12 +20,31 @@ Entity EntityCommandBuffer::createEntity(Archetype* archetype) {
     return entity;
 }
 
+void EntityCommandBuffer::createEntities(Archetype* archetype, std::span<Entity> entities) {
+    m_EntityManager->assignEntities(entities);
+    m_Procedures.emplace_back([this, archetype, entities = std::vector<Entity>(entities.begin(), entities.end())]() {
+        m_EntityManager->createEntitiesImmediately(entities, archetype);
+    });
+}
+
 void EntityCommandBuffer::destroyEntity(const Entity& entity) {
     m_Procedures.emplace_back([this, entity]() {
         m_EntityManager->destroyEntityImmediately(entity);
     });
 }
 
+void EntityCommandBuffer::destroyEntities(const EntityFilter& entityFilter) {
+    m_Procedures.emplace_back([this, entityFilter]() {
+        m_EntityManager->destroyEntitiesImmediately(entityFilter);
+    });
+}
+
+void EntityCommandBuffer::destroyEntities(std::span<const Entity> entities) {
+    m_Procedures.emplace_back([this, entities = std::vector<Entity>(entities.begin(), entities.end())]() {
+        m_EntityManager->destroyEntitiesImmediately(entities);
+    });
+}
+
 void EntityCommandBuffer::execute() {
     for (std::function<void()> const& procedure : m_Procedures)
         procedure();
@@ -44,10 +61,22 @@ Entity EntityManager::createEntity(Archetype* archetype) {
     return m_MainEntityCommandBuffer.createEntity(archetype);
 }
 
+void EntityManager::createEntities(Archetype* archetype, std::span<Entity> entities) {
+    m_MainEntityCommandBuffer.createEntities(archetype, entities);
+}
+
 void EntityManager::destroyEntity(const Entity& entity) {
     m_MainEntityCommandBuffer.destroyEntity(entity);
 }
 
+void EntityManager::destroyEntities(const EntityFilter& entityFilter) {
+    m_MainEntityCommandBuffer.destroyEntities(entityFilter);
+}
+
+void EntityManager::destroyEntities(std::span<const Entity> entities) {
+    m_MainEntityCommandBuffer.destroyEntities(entities);
+}
+
 std::vector<ChunkAccessor> EntityManager::filterEntities(const EntityFilter& entityFilter) {
     std::vector<ChunkAccessor> accessors;
     for (const auto& [mask, archetype] : m_ArchetypeMap)
@@ -57,6 +86,22 @@ std::vector<ChunkAccessor> EntityManager::filterEntities(const EntityFilter& ent
     return accessors;
 }
 
+EntityQuery* EntityManager::createEntityQuery(const EntityFilter& entityFilter) {
+    EntityQuery* entityQuery = m_EntityQueries.emplace_back(std::make_unique<EntityQuery>(entityFilter)).get();
+    for (std::unique_ptr<Archetype> const& archetype : m_Archetypes)
+        if (entityFilter.satisfied(archetype->mask()))
+            entityQuery->m_Archetypes.push_back(archetype.get());
+    return entityQuery;
+}
+
+std::vector<ChunkAccessor> EntityManager::filterEntities(const EntityQuery* entityQuery) {
+    std::vector<ChunkAccessor> accessors;
+    for (Archetype* archetype : entityQuery->archetypes())
+        if (archetype->entityCount() != 0)
+            archetype->filterEntities(entityQuery->entityFilter(), m_SharedComponentStore, accessors);
+    return accessors;
+}
+
 unsigned int EntityManager::chunkCount(const EntityFilter& entityFilter) const {
     unsigned int count = 0;
     for (const auto& [mask, archetype] : m_ArchetypeMap)
@@ -75,26 +120,149 @@ unsigned int EntityManager::entityCount(const EntityFilter& entityFilter) const
     return count;
 };
 
-unsigned int EntityManager::registerComponent(const std::type_index& typeIndex) {
-    return m_ComponentIdMap.try_emplace(typeIndex, m_ComponentIdMap.size()).first->second;
-}
-
-unsigned int EntityManager::registerSharedComponent(const std::type_index& typeIndex) {
-    return m_SharedComponentIdMap.try_emplace(typeIndex, m_SharedComponentIdMap.size()).first->second;
+unsigned int EntityManager::chunkCount(const EntityQuery* entityQuery) const {
+    unsigned int count = 0;
+    for (Archetype* archetype : entityQuery->archetypes())
+        count += archetype->chunkCount();
+    return count;
 }
 
-unsigned int EntityManager::registerSingletonComponent(const std::type_index& typeIndex) {
-    return m_SingletonComponentIdMap.try_emplace(typeIndex, m_SingletonComponentIdMap.size()).first->second;
+unsigned int EntityManager::entityCount(const EntityQuery* entityQuery) const {
+    unsigned int count = 0;
+    for (Archetype* archetype : entityQuery->archetypes())
+        count += archetype->entityCount();
+    return count;
 }
 
 Archetype* EntityManager::createArchetype(ArchetypeMask&& mask, std::vector<unsigned int>&& componentIds, std::vector<std::size_t>&& componentSizes, std::vector<std::size_t>&& componentAligns, std::vector<unsigned int>&& sharedComponentIds) {
     if (m_ArchetypeMap.contains(mask)) return m_ArchetypeMap[mask];
     const unsigned int archetypeId = m_ArchetypeIdCounter++;
-    Archetype* archetype = m_Archetypes.emplace_back(std::make_unique<Archetype>(archetypeId, mask, componentIds, componentSizes, componentAligns, sharedComponentIds, &m_ChunkPool)).get();
+    Archetype* archetype = m_Archetypes.emplace_back(std::make_unique<Archetype>(archetypeId, mask, componentIds, componentSizes, componentAligns, sharedComponentIds, &m_ChunkPool, m_Version)).get();
     m_ArchetypeMap.emplace(mask, archetype);
+    for (std::unique_ptr<EntityQuery> const& entityQuery : m_EntityQueries)
+        if (entityQuery->entityFilter().satisfied(archetype->mask()))
+            entityQuery->m_Archetypes.push_back(archetype);
     return archetype;
 }
 
+Archetype* EntityManager::archetypeAddingComponent(Archetype* srcArchetype, const unsigned int& componentId, const std::size_t& componentSize, const std::size_t& componentAlign, const bool& manual) {
+    // Mask is unchanged, caching an edge to itself would make the reverse edge point back to it
+    if (srcArchetype->mask().componentMask.test(componentId))
+        return srcArchetype;
+    Archetype*& dstArchetype = srcArchetype->m_ComponentAddedArchetypes[componentId];
+    if (dstArchetype != nullptr)
+        return dstArchetype;
+    ArchetypeMask mask = srcArchetype->mask();
+    mask.markComponent(componentId, manual);
+    if (m_ArchetypeMap.contains(mask))
+        dstArchetype = m_ArchetypeMap[mask];
+    else {
+        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
+        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
+        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
+        componentIds.push_back(componentId);
+        componentSizes.emplace_back(componentSize);
+        componentAligns.emplace_back(componentAlign);
+        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
+        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
+    }
+    dstArchetype->m_ComponentRemovedArchetypes.emplace(componentId, srcArchetype);
+    return dstArchetype;
+}
+
+Archetype* EntityManager::archetypeRemovingComponent(Archetype* srcArchetype, const unsigned int& componentId, const bool& manual) {
+    if (!srcArchetype->mask().componentMask.test(componentId))
+        return srcArchetype;
+    Archetype*& dstArchetype = srcArchetype->m_ComponentRemovedArchetypes[componentId];
+    if (dstArchetype != nullptr)
+        return dstArchetype;
+    ArchetypeMask mask = srcArchetype->mask();
+    mask.markComponent(componentId, manual, false);
+    if (m_ArchetypeMap.contains(mask))
+        dstArchetype = m_ArchetypeMap[mask];
+    else {
+        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
+        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
+        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
+        for (unsigned int i = 0; i < componentIds.size(); i++)
+            if (componentIds[i] == componentId) {
+                componentIds.erase(componentIds.begin() + i);
+                componentSizes.erase(componentSizes.begin() + i);
+                componentAligns.erase(componentAligns.begin() + i);
+                break;
+            }
+        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
+        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
+    }
+    dstArchetype->m_ComponentAddedArchetypes.emplace(componentId, srcArchetype);
+    return dstArchetype;
+}
+
+Archetype* EntityManager::archetypeAddingSharedComponent(Archetype* srcArchetype, const unsigned int& sharedComponentId, const bool& manual) {
+    if (srcArchetype->mask().sharedComponentMask.test(sharedComponentId))
+        return srcArchetype;
+    Archetype*& dstArchetype = srcArchetype->m_SharedComponentAddedArchetypes[sharedComponentId];
+    if (dstArchetype != nullptr)
+        return dstArchetype;
+    ArchetypeMask mask = srcArchetype->mask();
+    mask.markSharedComponent(sharedComponentId, manual);
+    if (m_ArchetypeMap.contains(mask))
+        dstArchetype = m_ArchetypeMap[mask];
+    else {
+        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
+        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
+        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
+        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
+        sharedComponentIds.push_back(sharedComponentId);
+        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
+    }
+    dstArchetype->m_SharedComponentRemovedArchetypes.emplace(sharedComponentId, srcArchetype);
+    return dstArchetype;
+}
+
+Archetype* EntityManager::archetypeRemovingSharedComponent(Archetype* srcArchetype, const unsigned int& sharedComponentId, const bool& manual) {
+    if (!srcArchetype->mask().sharedComponentMask.test(sharedComponentId))
+        return srcArchetype;
+    Archetype*& dstArchetype = srcArchetype->m_SharedComponentRemovedArchetypes[sharedComponentId];
+    if (dstArchetype != nullptr)
+        return dstArchetype;
+    ArchetypeMask mask = srcArchetype->mask();
+    mask.markSharedComponent(sharedComponentId, manual, false);
+    if (m_ArchetypeMap.contains(mask))
+        dstArchetype = m_ArchetypeMap[mask];
+    else {
+        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
+        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
+        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
+        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
+        for (unsigned int i = 0; i < sharedComponentIds.size(); i++)
+            if (sharedComponentIds[i] == sharedComponentId) {
+                sharedComponentIds.erase(sharedComponentIds.begin() + i);
+                break;
+            }
+        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
+    }
+    dstArchetype->m_SharedComponentAddedArchetypes.emplace(sharedComponentId, srcArchetype);
+    return dstArchetype;
+}
+
+std::vector<Archetype*> EntityManager::filterArchetypes(const EntityFilter& entityFilter) const {
+    std::vector<Archetype*> archetypes;
+    for (const auto& [mask, archetype] : m_ArchetypeMap)
+        if (entityFilter.satisfied(mask) && archetype->entityCount() != 0)
+            archetypes.push_back(archetype);
+    return archetypes;
+}
+
+std::vector<Entity> EntityManager::filterArchetypeEntities(Archetype* archetype, const EntityFilter& entityFilter) const {
+    std::vector<ChunkAccessor> accessors;
+    archetype->filterEntities(entityFilter, m_SharedComponentStore, accessors);
+    std::vector<Entity> entities;
+    for (const ChunkAccessor& accessor : accessors)
+        entities.insert(entities.end(), accessor.entityArray(), accessor.entityArray() + accessor.entityCount());
+    return entities;
+}
+
 Entity EntityManager::assignEntity() {
     std::lock_guard lock(m_EntityIdMutex);
     if (!m_FreeEntityIds.empty()) {
@@ -106,6 +274,18 @@ Entity EntityManager::assignEntity() {
     return Entity{m_EntityIdCounter++};
 }
 
+void EntityManager::assignEntities(std::span<Entity> entities) {
+    std::lock_guard lock(m_EntityIdMutex);
+    unsigned int i = 0;
+    for (; i < entities.size() && !m_FreeEntityIds.empty(); i++) {
+        entities[i] = Entity{m_FreeEntityIds.front()};
+        m_FreeEntityIds.pop();
+    }
+    m_EntityLocations.resize(m_EntityLocations.size() + entities.size() - i, Archetype::EntityLocation::invalidEntityLocation());
+    for (; i < entities.size(); i++)
+        entities[i] = Entity{m_EntityIdCounter++};
+}
+
 void EntityManager::createEntityImmediately(const Entity& entity) {
     Archetype* const archetype = createArchetypeBuilder().createArchetype();
     createEntityImmediately(entity, archetype);
@@ -117,6 +297,13 @@ void EntityManager::createEntityImmediately(const Entity& entity, Archetype* arc
     m_EntityLocations[entity.id] = location;
 }
 
+void EntityManager::createEntitiesImmediately(std::span<const Entity> entities, Archetype* archetype) {
+    unsigned int combinationIndex, firstEntityIndexInCombination;
+    archetype->addEntities(entities, combinationIndex, firstEntityIndexInCombination);
+    for (unsigned int i = 0; i < entities.size(); i++)
+        m_EntityLocations[entities[i].id] = Archetype::EntityLocation{archetype->id(), combinationIndex, firstEntityIndexInCombination + i};
+}
+
 void EntityManager::destroyEntityImmediately(const Entity& entity) {
     const Archetype::EntityLocation location = m_EntityLocations[entity.id];
     Archetype* archetype = m_Archetypes[location.archetypeId].get();
@@ -136,6 +323,69 @@ void EntityManager::destroyEntityImmediately(const Entity& entity) {
     destroyEntityWithoutCheck(entity, archetype, location);
 }
 
+void EntityManager::destroyEntitiesImmediately(const EntityFilter& entityFilter) {
+    std::vector<Entity> entities;
+    for (Archetype* archetype : filterArchetypes(entityFilter)) {
+        // Chunk versions decide which Entities are matched, so the whole Archetype could not be cleared
+        if (entityFilter.changedComponentMask.any()) {
+            const std::vector<Entity> changedEntities = filterArchetypeEntities(archetype, entityFilter);
+            destroyEntitiesImmediately(changedEntities);
+            continue;
+        }
+        if (archetype->partiallyManual() || archetype->fullyManual()) {
+            for (const Entity& entity : filterArchetypeEntities(archetype, entityFilter))
+                destroyEntityImmediately(entity);
+            continue;
+        }
+        archetype->removeAllEntities(m_SharedComponentStore, entities);
+    }
+    for (const Entity& entity : entities)
+        m_EntityLocations[entity.id] = Archetype::EntityLocation::invalidEntityLocation();
+}
+
+void EntityManager::destroyEntitiesImmediately(std::span<const Entity> entities) {
+    // Sort by location so Entities of a Combination are adjacent in ascending order, duplicated Entities are skipped
+    std::vector<std::pair<Archetype::EntityLocation, Entity>> locatedEntities;
+    locatedEntities.reserve(entities.size());
+    for (const Entity& entity : entities)
+        if (m_EntityLocations[entity.id].valid())
+            locatedEntities.emplace_back(m_EntityLocations[entity.id], entity);
+    const auto locationKey = [](const Archetype::EntityLocation& location) { return std::tie(location.archetypeId, location.combinationIndex, location.entityIndexInCombination); };
+    std::sort(locatedEntities.begin(), locatedEntities.end(), [&locationKey](const auto& lhs, const auto& rhs) { return locationKey(lhs.first) < locationKey(rhs.first); });
+    locatedEntities.erase(std::unique(locatedEntities.begin(), locatedEntities.end(), [](const auto& lhs, const auto& rhs) { return lhs.second.id == rhs.second.id; }), locatedEntities.end());
+
+    std::vector<Entity> removedEntities;
+    std::vector<unsigned int> entityIndices;
+    std::vector<std::pair<Entity, unsigned int>> movedEntities;
+    for (std::size_t begin = 0, end; begin < locatedEntities.size(); begin = end) {
+        const Archetype::EntityLocation location = locatedEntities[begin].first;
+        for (end = begin + 1; end < locatedEntities.size(); end++)
+            if (locatedEntities[end].first.archetypeId != location.archetypeId || locatedEntities[end].first.combinationIndex != location.combinationIndex)
+                break;
+        Archetype* archetype = m_Archetypes[location.archetypeId].get();
+        if (archetype->partiallyManual() || archetype->fullyManual()) {
+            for (std::size_t i = begin; i < end; i++)
+                destroyEntityImmediately(locatedEntities[i].second);
+            continue;
+        }
+        if (archetype->entityCount(location.combinationIndex) == end - begin) {
+            archetype->removeCombination(location.combinationIndex, m_SharedComponentStore, removedEntities);
+            continue;
+        }
+        entityIndices.clear();
+        for (std::size_t i = begin; i < end; i++) {
+            entityIndices.push_back(locatedEntities[i].first.entityIndexInCombination);
+            removedEntities.push_back(locatedEntities[i].second);
+        }
+        movedEntities.clear();
+        archetype->removeEntities(location.combinationIndex, entityIndices, m_SharedComponentStore, movedEntities);
+        for (const auto& [entity, entityIndexInCombination] : movedEntities)
+            m_EntityLocations[entity.id].entityIndexInCombination = entityIndexInCombination;
+    }
+    for (const Entity& entity : removedEntities)
+        m_EntityLocations[entity.id] = Archetype::EntityLocation::invalidEntityLocation();
+}
+
 void EntityManager::destroyEntityWithoutCheck(const Entity& entity, Archetype* archetype, const Archetype::EntityLocation& location) {
     std::vector<unsigned int> const& sharedComponentIds = archetype->sharedComponentIds();
     std::vector<unsigned int> sharedComponentIndices;
@@ -151,26 +401,7 @@ void EntityManager::destroyEntityWithoutCheck(const Entity& entity, Archetype* a
 void EntityManager::removeComponentWithoutCheck(const Entity& entity, const unsigned int& componentId, const bool& manual) {
     const Archetype::EntityLocation srcLocation = m_EntityLocations[entity.id];
     Archetype* const srcArchetype = m_Archetypes[srcLocation.archetypeId].get();
-    ArchetypeMask mask = srcArchetype->mask();
-    mask.markComponent(componentId, manual, false);
-
-    Archetype* dstArchetype;
-    if (m_ArchetypeMap.contains(mask))
-        dstArchetype = m_ArchetypeMap[mask];
-    else {
-        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
-        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
-        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
-        for (unsigned int i = 0; i < componentIds.size(); i++)
-            if (componentIds[i] == componentId) {
-                componentIds.erase(componentIds.begin() + i);
-                componentSizes.erase(componentSizes.begin() + i);
-                componentAligns.erase(componentAligns.begin() + i);
-                break;
-            }
-        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
-        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
-    }
+    Archetype* const dstArchetype = archetypeRemovingComponent(srcArchetype, componentId, manual);
 
     Entity srcSwappedEntity;
     Archetype::EntityLocation dstLocation;
@@ -183,24 +414,7 @@ void EntityManager::removeComponentWithoutCheck(const Entity& entity, const unsi
 void EntityManager::removeSharedComponentWithoutCheck(const Entity& entity, const unsigned int& sharedComponentId, const bool& manual) {
     const Archetype::EntityLocation srcLocation = m_EntityLocations[entity.id];
     Archetype* const srcArchetype = m_Archetypes[srcLocation.archetypeId].get();
-    ArchetypeMask mask = srcArchetype->mask();
-    mask.markSharedComponent(sharedComponentId, manual, false);
-
-    Archetype* dstArchetype;
-    if (m_ArchetypeMap.contains(mask))
-        dstArchetype = m_ArchetypeMap[mask];
-    else {
-        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
-        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
-        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
-        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
-        for (unsigned int i = 0; i < sharedComponentIds.size(); i++)
-            if (sharedComponentIds[i] == sharedComponentId) {
-                sharedComponentIds.erase(sharedComponentIds.begin() + i);
-                break;
-            }
-        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
-    }
+    Archetype* const dstArchetype = archetypeRemovingSharedComponent(srcArchetype, sharedComponentId, manual);
 
     unsigned int sharedComponentIndex;
     Entity srcSwappedEntity;
@@ -214,6 +428,7 @@ void EntityManager::removeSharedComponentWithoutCheck(const Entity& entity, cons
 }
 
 void EntityManager::executeEntityCommandBuffers() {
+    m_Version++;
     m_MainEntityCommandBuffer.execute();
     for (std::unique_ptr<EntityCommandBuffer> const& buffer : m_TaskEntityCommandBuffers)
         buffer->execute();
@@ -6,24 +6,26 @@
 #include <MelonCore/DataComponent.h>
 #include <MelonCore/Entity.h>
 #include <MelonCore/EntityFilter.h>
+#include <MelonCore/EntityQuery.h>
 #include <MelonCore/ObjectPool.h>
 #include <MelonCore/ObjectStore.h>
 #include <MelonCore/SharedComponent.h>
 #include <MelonCore/SingletonComponent.h>
 #include <MelonCore/SingletonObjectStore.h>
+#include <MelonCore/TypeId.h>
 
 #include <algorithm>
 #include <array>
 #include <bitset>
+#include <cassert>
 #include <cstdlib>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <span>
 #include <tuple>
 #include <type_traits>
-#include <typeindex>
-#include <typeinfo>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -70,7 +72,12 @@ class EntityFilterBuilder {
     template <typename Type>
     EntityFilterBuilder& rejectSharedComponent(const Type& sharedComponent);
 
+    // Only chunks with one of the components written in or after the version, see EntityManager::version()
+    template <typename... Types>
+    EntityFilterBuilder& changedSince(const unsigned int& version);
+
     EntityFilter createEntityFilter();
+    EntityQuery* createEntityQuery();
 
   private:
     EntityFilterBuilder(EntityManager* entityManager) : m_EntityManager(entityManager) {}
@@ -86,11 +93,21 @@ class EntityCommandBuffer {
 
     Entity createEntity();
     Entity createEntity(Archetype* archetype);
+    // Create as many Entities as the span holds, ids are assigned at once and written to the span
+    void createEntities(Archetype* archetype, std::span<Entity> entities);
     void destroyEntity(const Entity& entity);
+    // Destroy Entities in bulk, Combinations fully selected are cleared and their chunks recycled at once
+    void destroyEntities(const EntityFilter& entityFilter);
+    void destroyEntities(std::span<const Entity> entities);
     template <typename Type>
     void addComponent(const Entity& entity, const Type& component);
     template <typename Type>
     void removeComponent(const Entity& entity);
+    // Add or remove the component for all Entities satisfying the filter, chunks are migrated by whole columns
+    template <typename Type>
+    void addComponent(const EntityFilter& entityFilter, const Type& component);
+    template <typename Type>
+    void removeComponent(const EntityFilter& entityFilter);
     template <typename Type>
     void setComponent(const Entity& entity, const Type& component);
     template <typename Type>
@@ -128,11 +145,21 @@ class EntityManager {
 
     Entity createEntity();
     Entity createEntity(Archetype* archetype);
+    // Create as many Entities as the span holds, ids are assigned at once and written to the span
+    void createEntities(Archetype* archetype, std::span<Entity> entities);
     void destroyEntity(const Entity& entity);
+    // Destroy Entities in bulk, Combinations fully selected are cleared and their chunks recycled at once
+    void destroyEntities(const EntityFilter& entityFilter);
+    void destroyEntities(std::span<const Entity> entities);
     template <typename Type>
     void addComponent(const Entity& entity, const Type& component);
     template <typename Type>
     void removeComponent(const Entity& entity);
+    // Add or remove the component for all Entities satisfying the filter, chunks are migrated by whole columns
+    template <typename Type>
+    void addComponent(const EntityFilter& entityFilter, const Type& component);
+    template <typename Type>
+    void removeComponent(const EntityFilter& entityFilter);
     template <typename Type>
     void setComponent(const Entity& entity, const Type& component);
     template <typename Type>
@@ -150,13 +177,17 @@ class EntityManager {
 
     EntityFilterBuilder createEntityFilterBuilder() { return EntityFilterBuilder(this); }
     std::vector<ChunkAccessor> filterEntities(const EntityFilter& entityFilter);
+    // Queries are owned by the EntityManager, matching Archetypes are collected once instead of on each filtering
+    EntityQuery* createEntityQuery(const EntityFilter& entityFilter);
+    std::vector<ChunkAccessor> filterEntities(const EntityQuery* entityQuery);
 
+    // Ids are assigned once for each type and shared by all EntityManagers, so they are never looked up by type
     template <typename Type>
-    unsigned int componentId();
+    static unsigned int componentId();
     template <typename Type>
-    unsigned int sharedComponentId();
+    static unsigned int sharedComponentId();
     template <typename Type>
-    unsigned int singletonComponentId();
+    static unsigned int singletonComponentId();
 
     template <typename Type>
     const Type* sharedComponent(const unsigned int& sharedComponentIndex) const;
@@ -168,27 +199,40 @@ class EntityManager {
 
     unsigned int chunkCount(const EntityFilter& entityFilter) const;
     unsigned int entityCount(const EntityFilter& entityFilter) const;
+    unsigned int chunkCount(const EntityQuery* entityQuery) const;
+    unsigned int entityCount(const EntityQuery* entityQuery) const;
+
+    // Increased once per World update before EntityCommandBuffers are executed, chunks record it when their components are written
+    // Tasks of an update may write after later systems filter, so a system passing the version of its last update to changedSince sees them all
+    const unsigned int& version() const { return m_Version; }
 
   private:
-    template <typename Type>
-    unsigned int registerComponent();
-    unsigned int registerComponent(const std::type_index& typeIndex);
-    template <typename Type>
-    unsigned int registerSharedComponent();
-    unsigned int registerSharedComponent(const std::type_index& typeIndex);
-    template <typename Type>
-    unsigned int registerSingletonComponent();
-    unsigned int registerSingletonComponent(const std::type_index& typeIndex);
     Archetype* createArchetype(ArchetypeMask&& mask, std::vector<unsigned int>&& componentIds, std::vector<std::size_t>&& componentSizes, std::vector<std::size_t>&& componentAligns, std::vector<unsigned int>&& sharedComponentIds);
+    Archetype* archetypeAddingComponent(Archetype* srcArchetype, const unsigned int& componentId, const std::size_t& componentSize, const std::size_t& componentAlign, const bool& manual);
+    Archetype* archetypeRemovingComponent(Archetype* srcArchetype, const unsigned int& componentId, const bool& manual);
+    Archetype* archetypeAddingSharedComponent(Archetype* srcArchetype, const unsigned int& sharedComponentId, const bool& manual);
+    Archetype* archetypeRemovingSharedComponent(Archetype* srcArchetype, const unsigned int& sharedComponentId, const bool& manual);
+    // Non-empty archetypes satisfying the filter, collected before archetypes may be created
+    std::vector<Archetype*> filterArchetypes(const EntityFilter& entityFilter) const;
+    // Entities of the Archetype in chunks satisfying the filter, collected before they are moved or destroyed
+    std::vector<Entity> filterArchetypeEntities(Archetype* archetype, const EntityFilter& entityFilter) const;
     Entity assignEntity();
+    void assignEntities(std::span<Entity> entities);
     void createEntityImmediately(const Entity& entity);
     void createEntityImmediately(const Entity& entity, Archetype* archetype);
+    void createEntitiesImmediately(std::span<const Entity> entities, Archetype* archetype);
     void destroyEntityImmediately(const Entity& entityId);
+    void destroyEntitiesImmediately(const EntityFilter& entityFilter);
+    void destroyEntitiesImmediately(std::span<const Entity> entities);
     template <typename Type>
     void addComponentImmediately(const Entity& entity, const Type& component);
     template <typename Type>
     void removeComponentImmediately(const Entity& entity);
     template <typename Type>
+    void addComponentImmediately(const EntityFilter& entityFilter, const Type& component);
+    template <typename Type>
+    void removeComponentImmediately(const EntityFilter& entityFilter);
+    template <typename Type>
     void setComponentImmediately(const Entity& entity, const Type& component);
     template <typename Type>
     void addSharedComponentImmediately(const Entity& entity, const Type& sharedComponent);
@@ -209,18 +253,17 @@ class EntityManager {
 
     void executeEntityCommandBuffers();
 
-    std::unordered_map<std::type_index, unsigned int> m_ComponentIdMap;
-    std::unordered_map<std::type_index, unsigned int> m_SharedComponentIdMap;
-    std::unordered_map<std::type_index, unsigned int> m_SingletonComponentIdMap;
-
     ObjectPool<Chunk> m_ChunkPool;
 
     ObjectStore<ArchetypeMask::k_MaxSharedComponentIdCount> m_SharedComponentStore;
     SingletonObjectStore<k_MaxSingletonComponentIdCount> m_SingletonComponentStore;
 
+    unsigned int m_Version{1};
+
     unsigned int m_ArchetypeIdCounter{};
     std::unordered_map<ArchetypeMask, Archetype*, ArchetypeMask::Hash> m_ArchetypeMap;
     std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+    std::vector<std::unique_ptr<EntityQuery>> m_EntityQueries;
 
     // TODO: To avoid contention, a few reserved Entity id could be passed to EntityCommandBuffer in main thread.
     std::mutex m_EntityIdMutex;
@@ -243,7 +286,7 @@ ArchetypeBuilder& ArchetypeBuilder::markComponents() {
     // TODO: Check if derived from DataComponent, which should be encapsulated in a method
     static_assert(std::is_same_v<std::tuple<std::true_type, std::bool_constant<std::is_base_of_v<DataComponent, Types>>...>, std::tuple<std::bool_constant<std::is_base_of_v<DataComponent, Types>>..., std::true_type>>);
     std::vector<unsigned int> const componentIds{m_EntityManager->componentId<Types>()...};
-    std::vector<std::size_t> const componentSizes{sizeof(Types)...};
+    std::vector<std::size_t> const componentSizes{componentSize<Types>()...};
     std::vector<std::size_t> const componentAligns{alignof(Types)...};
     m_ComponentIds.insert(m_ComponentIds.end(), componentIds.begin(), componentIds.end());
     m_ComponentSizes.insert(m_ComponentSizes.end(), componentSizes.begin(), componentSizes.end());
@@ -319,11 +362,25 @@ EntityFilterBuilder& EntityFilterBuilder::rejectSharedComponent(const Type& shar
     return *this;
 }
 
+template <typename... Types>
+EntityFilterBuilder& EntityFilterBuilder::changedSince(const unsigned int& version) {
+    static_assert(std::is_same_v<std::tuple<std::true_type, std::bool_constant<std::is_base_of_v<DataComponent, Types>>...>, std::tuple<std::bool_constant<std::is_base_of_v<DataComponent, Types>>..., std::true_type>>);
+    std::vector<unsigned int> const& componentIds{m_EntityManager->componentId<Types>()...};
+    for (const unsigned int& cmptId : componentIds)
+        m_EntityFilter.changedComponentMask.set(cmptId);
+    m_EntityFilter.changedSinceVersion = version;
+    return *this;
+}
+
 inline EntityFilter EntityFilterBuilder::createEntityFilter() {
     std::sort(m_EntityFilter.requiredSharedComponentIdAndIndices.begin(), m_EntityFilter.requiredSharedComponentIdAndIndices.end());
     return std::move(m_EntityFilter);
 }
 
+inline EntityQuery* EntityFilterBuilder::createEntityQuery() {
+    return m_EntityManager->createEntityQuery(createEntityFilter());
+}
+
 template <typename Type>
 void EntityCommandBuffer::addComponent(const Entity& entity, const Type& component) {
     static_assert(std::is_base_of_v<DataComponent, Type>);
@@ -340,6 +397,22 @@ void EntityCommandBuffer::removeComponent(const Entity& entity) {
     });
 }
 
+template <typename Type>
+void EntityCommandBuffer::addComponent(const EntityFilter& entityFilter, const Type& component) {
+    static_assert(std::is_base_of_v<DataComponent, Type>);
+    m_Procedures.emplace_back([this, entityFilter, component]() {
+        m_EntityManager->addComponentImmediately(entityFilter, component);
+    });
+}
+
+template <typename Type>
+void EntityCommandBuffer::removeComponent(const EntityFilter& entityFilter) {
+    static_assert(std::is_base_of_v<DataComponent, Type>);
+    m_Procedures.emplace_back([this, entityFilter]() {
+        m_EntityManager->removeComponentImmediately<Type>(entityFilter);
+    });
+}
+
 template <typename Type>
 void EntityCommandBuffer::setComponent(const Entity& entity, const Type& component) {
     static_assert(std::is_base_of_v<DataComponent, Type>);
@@ -408,6 +481,18 @@ void EntityManager::removeComponent(const Entity& entity) {
     m_MainEntityCommandBuffer.removeComponent<Type>(entity);
 }
 
+template <typename Type>
+void EntityManager::addComponent(const EntityFilter& entityFilter, const Type& component) {
+    static_assert(std::is_base_of_v<DataComponent, Type>);
+    m_MainEntityCommandBuffer.addComponent(entityFilter, component);
+}
+
+template <typename Type>
+void EntityManager::removeComponent(const EntityFilter& entityFilter) {
+    static_assert(std::is_base_of_v<DataComponent, Type>);
+    m_MainEntityCommandBuffer.removeComponent<Type>(entityFilter);
+}
+
 template <typename Type>
 void EntityManager::setComponent(const Entity& entity, const Type& component) {
     static_assert(std::is_base_of_v<DataComponent, Type>);
@@ -453,19 +538,25 @@ void EntityManager::setSingletonComponent(const Type& singletonComponent) {
 template <typename Type>
 unsigned int EntityManager::componentId() {
     static_assert(std::is_base_of_v<DataComponent, Type>);
-    return registerComponent<Type>();
+    const unsigned int id = TypeId<DataComponent>::of<Type>();
+    assert(id < ArchetypeMask::k_MaxComponentIdCount);
+    return id;
 }
 
 template <typename Type>
 unsigned int EntityManager::sharedComponentId() {
     static_assert(std::is_base_of_v<SharedComponent, Type>);
-    return registerSharedComponent<Type>();
+    const unsigned int id = TypeId<SharedComponent>::of<Type>();
+    assert(id < ArchetypeMask::k_MaxSharedComponentIdCount);
+    return id;
 }
 
 template <typename Type>
 unsigned int EntityManager::singletonComponentId() {
     static_assert(std::is_base_of_v<SingletonComponent, Type>);
-    return registerSingletonComponent<Type>();
+    const unsigned int id = TypeId<SingletonComponent>::of<Type>();
+    assert(id < k_MaxSingletonComponentIdCount);
+    return id;
 }
 
 template <typename Type>
@@ -477,7 +568,7 @@ const Type* EntityManager::sharedComponent(const unsigned int& sharedComponentIn
 template <typename Type>
 unsigned int EntityManager::sharedComponentIndex(const Type& sharedComponent) const {
     static_assert(std::is_base_of_v<SharedComponent, Type>);
-    const unsigned int sharedComponentId = registerSharedComponent<Type>();
+    const unsigned int sharedComponentId = EntityManager::sharedComponentId<Type>();
     return m_SharedComponentStore.objectIndex(sharedComponentId, sharedComponent);
 }
 
@@ -487,42 +578,12 @@ Type* EntityManager::singletonComponent(const unsigned int& singletonComponentId
     return m_SingletonComponentStore.object<Type>(singletonComponentId);
 }
 
-template <typename Type>
-unsigned int EntityManager::registerComponent() {
-    return registerComponent(typeid(Type));
-}
-
-template <typename Type>
-unsigned int EntityManager::registerSharedComponent() {
-    return registerSharedComponent(typeid(Type));
-}
-
-template <typename Type>
-unsigned int EntityManager::registerSingletonComponent() {
-    return registerSingletonComponent(typeid(Type));
-}
-
 template <typename Type>
 void EntityManager::addComponentImmediately(const Entity& entity, const Type& component) {
     const Archetype::EntityLocation srcLocation = m_EntityLocations[entity.id];
     Archetype* const srcArchetype = m_Archetypes[srcLocation.archetypeId].get();
-    const unsigned int componentId = registerComponent<Type>();
-    ArchetypeMask mask = srcArchetype->mask();
-    mask.markComponent(componentId, std::is_base_of_v<ManualDataComponent, Type>);
-
-    Archetype* dstArchetype;
-    if (m_ArchetypeMap.contains(mask))
-        dstArchetype = m_ArchetypeMap[mask];
-    else {
-        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
-        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
-        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
-        componentIds.push_back(componentId);
-        componentSizes.emplace_back(sizeof(Type));
-        componentAligns.emplace_back(alignof(Type));
-        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
-        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
-    }
+    const unsigned int componentId = EntityManager::componentId<Type>();
+    Archetype* const dstArchetype = archetypeAddingComponent(srcArchetype, componentId, componentSize<Type>(), alignof(Type), std::is_base_of_v<ManualDataComponent, Type>);
 
     Entity srcSwappedEntity;
     Archetype::EntityLocation dstLocation;
@@ -541,14 +602,53 @@ void EntityManager::removeComponentImmediately(const Entity& entity) {
         destroyEntityWithoutCheck(entity, srcArchetype, srcLocation);
         return;
     }
-    removeComponentWithoutCheck(entity, registerComponent<Type>(), std::is_base_of_v<ManualDataComponent, Type>);
+    removeComponentWithoutCheck(entity, componentId<Type>(), std::is_base_of_v<ManualDataComponent, Type>);
+}
+
+template <typename Type>
+void EntityManager::addComponentImmediately(const EntityFilter& entityFilter, const Type& component) {
+    const unsigned int componentId = EntityManager::componentId<Type>();
+    for (Archetype* srcArchetype : filterArchetypes(entityFilter)) {
+        if (srcArchetype->mask().componentMask.test(componentId)) continue;
+        // Chunk versions decide which Entities are matched, so they are moved one by one
+        if (entityFilter.changedComponentMask.any()) {
+            for (const Entity& entity : filterArchetypeEntities(srcArchetype, entityFilter))
+                addComponentImmediately(entity, component);
+            continue;
+        }
+        Archetype* const dstArchetype = archetypeAddingComponent(srcArchetype, componentId, componentSize<Type>(), alignof(Type), std::is_base_of_v<ManualDataComponent, Type>);
+        dstArchetype->moveAllEntities(srcArchetype, componentId, static_cast<const void*>(&component), m_EntityLocations);
+    }
+}
+
+template <typename Type>
+void EntityManager::removeComponentImmediately(const EntityFilter& entityFilter) {
+    const unsigned int componentId = EntityManager::componentId<Type>();
+    for (Archetype* srcArchetype : filterArchetypes(entityFilter)) {
+        if (!srcArchetype->mask().componentMask.test(componentId)) continue;
+        if (entityFilter.changedComponentMask.any()) {
+            for (const Entity& entity : filterArchetypeEntities(srcArchetype, entityFilter))
+                removeComponentImmediately<Type>(entity);
+            continue;
+        }
+        // If the archetype is single and manual, its Entities should be destroyed
+        if (srcArchetype->single() && srcArchetype->fullyManual()) {
+            std::vector<Entity> entities;
+            srcArchetype->removeAllEntities(m_SharedComponentStore, entities);
+            for (const Entity& entity : entities)
+                m_EntityLocations[entity.id] = Archetype::EntityLocation::invalidEntityLocation();
+            continue;
+        }
+        Archetype* const dstArchetype = archetypeRemovingComponent(srcArchetype, componentId, std::is_base_of_v<ManualDataComponent, Type>);
+        dstArchetype->moveAllEntities(srcArchetype, componentId, nullptr, m_EntityLocations);
+    }
 }
 
 template <typename Type>
 void EntityManager::setComponentImmediately(const Entity& entity, const Type& component) {
     const Archetype::EntityLocation location = m_EntityLocations[entity.id];
     Archetype* const archetype = m_Archetypes[location.archetypeId].get();
-    const unsigned int componentId = m_ComponentIdMap.at(typeid(Type));
+    const unsigned int componentId = EntityManager::componentId<Type>();
     archetype->setComponent(location, componentId, static_cast<const void*>(&component));
 }
 
@@ -556,21 +656,8 @@ template <typename Type>
 void EntityManager::addSharedComponentImmediately(const Entity& entity, const Type& sharedComponent) {
     const Archetype::EntityLocation srcLocation = m_EntityLocations[entity.id];
     Archetype* const srcArchetype = m_Archetypes[srcLocation.archetypeId].get();
-    const unsigned int sharedComponentId = registerSharedComponent<Type>();
-    ArchetypeMask mask = srcArchetype->mask();
-    mask.markSharedComponent(sharedComponentId, std::is_base_of_v<ManualSharedComponent, Type>);
-
-    Archetype* dstArchetype;
-    if (m_ArchetypeMap.contains(mask))
-        dstArchetype = m_ArchetypeMap[mask];
-    else {
-        std::vector<unsigned int> componentIds = srcArchetype->componentIds();
-        std::vector<std::size_t> componentSizes = srcArchetype->componentSizes();
-        std::vector<std::size_t> componentAligns = srcArchetype->componentAligns();
-        std::vector<unsigned int> sharedComponentIds = srcArchetype->sharedComponentIds();
-        sharedComponentIds.push_back(sharedComponentId);
-        dstArchetype = createArchetype(std::move(mask), std::move(componentIds), std::move(componentSizes), std::move(componentAligns), std::move(sharedComponentIds));
-    }
+    const unsigned int sharedComponentId = EntityManager::sharedComponentId<Type>();
+    Archetype* const dstArchetype = archetypeAddingSharedComponent(srcArchetype, sharedComponentId, std::is_base_of_v<ManualSharedComponent, Type>);
 
     unsigned int sharedComponentIndex = m_SharedComponentStore.push(sharedComponentId, sharedComponent);
 
@@ -591,14 +678,14 @@ void EntityManager::removeSharedComponentImmediately(const Entity& entity) {
         destroyEntityWithoutCheck(entity, srcArchetype, srcLocation);
         return;
     }
-    removeSharedComponentWithoutCheck(entity, registerSharedComponent<Type>(), std::is_base_of_v<ManualSharedComponent, Type>);
+    removeSharedComponentWithoutCheck(entity, sharedComponentId<Type>(), std::is_base_of_v<ManualSharedComponent, Type>);
 }
 
 template <typename Type>
 void EntityManager::setSharedComponentImmediately(const Entity& entity, const Type& sharedComponent) {
     const Archetype::EntityLocation location = m_EntityLocations[entity.id];
     Archetype* const archetype = m_Archetypes[location.archetypeId].get();
-    const unsigned int sharedComponentId = registerSharedComponent<Type>();
+    const unsigned int sharedComponentId = EntityManager::sharedComponentId<Type>();
 
     unsigned int sharedComponentIndex = m_SharedComponentStore.push(sharedComponentId, sharedComponent);
 
@@ -615,17 +702,17 @@ void EntityManager::setSharedComponentImmediately(const Entity& entity, const Ty
 
 template <typename Type>
 void EntityManager::addSingletonComponentImmediately(const Type& singletonComponent) {
-    m_SingletonComponentStore.push(registerSingletonComponent<Type>(), singletonComponent);
+    m_SingletonComponentStore.push(singletonComponentId<Type>(), singletonComponent);
 }
 
 template <typename Type>
 void EntityManager::removeSingletonComponentImmediately() {
-    m_SingletonComponentStore.pop(registerSingletonComponent<Type>());
+    m_SingletonComponentStore.pop(singletonComponentId<Type>());
 }
 
 template <typename Type>
 void EntityManager::setSingletonComponentImmediately(const Type& singletonComponent) {
-    *m_SingletonComponentStore.object(registerSingletonComponent<Type>()) = singletonComponent;
+    *m_SingletonComponentStore.object(singletonComponentId<Type>()) = singletonComponent;
 }
 
 }  // namespace Melon
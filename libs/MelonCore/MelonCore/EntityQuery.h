@@ -0,0 +1,27 @@
+#pragma once
+
+#include <MelonCore/Archetype.h>
+#include <MelonCore/EntityFilter.h>
+
+#include <vector>
+
+namespace Melon {
+
+// Archetypes satisfying an EntityFilter, EntityManager appends Archetypes to it as they are created
+class EntityQuery {
+  public:
+    EntityQuery(const EntityFilter& entityFilter) : m_EntityFilter(entityFilter) {}
+
+    const EntityFilter& entityFilter() const { return m_EntityFilter; }
+    // Matching Archetypes only depend on the components, so the version could be moved forward on each update
+    void changedSince(const unsigned int& version) { m_EntityFilter.changedSinceVersion = version; }
+    std::vector<Archetype*> const& archetypes() const { return m_Archetypes; }
+
+  private:
+    EntityFilter m_EntityFilter;
+    std::vector<Archetype*> m_Archetypes;
+
+    friend class EntityManager;
+};
+
+}  // namespace Melon
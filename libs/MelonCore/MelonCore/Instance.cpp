@@ -4,7 +4,7 @@
 
 namespace Melon {
 
-Instance::Instance() {
+Instance::Instance(const TaskManagerConfiguration& taskManagerConfiguration) : m_TaskManager(taskManagerConfiguration) {
     m_DefaultWorld = std::make_unique<World>(&m_TaskManager);
 }
 
@@ -16,7 +16,8 @@ class World;
 
 class Instance {
   public:
-    Instance();
+    Instance() : Instance(TaskManagerConfiguration{}) {}
+    Instance(const TaskManagerConfiguration& taskManagerConfiguration);
 
     Instance& setApplicationName(const std::string& applicationName) {
         m_ApplicationName = applicationName;
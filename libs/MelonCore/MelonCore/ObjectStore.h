@@ -17,7 +17,8 @@ class ObjectStore {
 
     template <typename Type>
     unsigned int push(const unsigned int& typeId, const Type& object);
-    void pop(const unsigned int& typeId, const unsigned int& index);
+    // Release count references at once
+    void pop(const unsigned int& typeId, const unsigned int& index, const unsigned int& count = 1);
 
     template <typename Type>
     const Type* object(const unsigned int& index) const;
@@ -101,10 +102,10 @@ inline unsigned int ObjectStore<Count>::push(const unsigned int& typeId, const T
 }
 
 template <std::size_t Count>
-inline void ObjectStore<Count>::pop(const unsigned int& typeId, const unsigned int& index) {
+inline void ObjectStore<Count>::pop(const unsigned int& typeId, const unsigned int& index, const unsigned int& count) {
     if (index == k_InvalidIndex) return;
     void* object = m_Store[index];
-    m_ReferenceCounts[index]--;
+    m_ReferenceCounts[index] -= count;
     bool removed = m_ReferenceCounts[index] == 0;
     if (removed) {
         m_FreeIndices.push_back(index);
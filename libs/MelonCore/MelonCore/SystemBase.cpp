@@ -1,51 +1,82 @@
 #include <MelonCore/SystemBase.h>
 #include <MelonTask/TaskManager.h>
 
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
+
 namespace Melon {
 
-std::shared_ptr<TaskHandle> SystemBase::schedule(std::shared_ptr<ChunkTask> const& chunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor) {
-    std::shared_ptr<std::vector<ChunkAccessor>> accessors = std::make_shared<std::vector<ChunkAccessor>>(m_EntityManager->filterEntities(entityFilter));
-    if (accessors->size() == 0) return predecessor;
-    const unsigned int taskCount = std::min(TaskManager::k_WorkerCount, (static_cast<unsigned int>(accessors->size()) - 1) / k_MinChunkCountPerTask + 1);
-    const unsigned int chunkCountPerTask = accessors->size() / taskCount;
-    std::vector<std::shared_ptr<TaskHandle>> taskHandles(taskCount);
-    unsigned int chunkCounter = 0;
+namespace {
+
+// Each slice of chunks is a task, and all of them are queued at once
+// execute is called with the ChunkAccessor, the chunk index and the index of its first Entity
+template <typename Execute>
+std::shared_ptr<TaskHandle> scheduleSlices(TaskManager* taskManager, std::vector<ChunkAccessor>&& chunkAccessors, Execute&& execute, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    if (chunkAccessors.empty()) return predecessor;
+    std::shared_ptr<std::vector<ChunkAccessor>> accessors = std::make_shared<std::vector<ChunkAccessor>>(std::move(chunkAccessors));
+    std::shared_ptr<std::vector<unsigned int>> firstEntityIndices = std::make_shared<std::vector<unsigned int>>(accessors->size());
     unsigned int entityCounter = 0;
-    for (unsigned int i = 0; i < taskCount; i++) {
-        taskHandles[i] = m_TaskManager->schedule(
-            [chunkTask, accessors, chunkCountPerTask, i, chunkCounter, entityCounter]() {
-                for (unsigned int j = i * chunkCountPerTask; j < (i + 1) * chunkCountPerTask && j < accessors->size(); j++)
-                    chunkTask->execute((*accessors)[j], chunkCounter, entityCounter);
-            },
-            {predecessor});
-        chunkCounter += chunkCountPerTask;
-        for (unsigned int j = i * chunkCountPerTask; j < (i + 1) * chunkCountPerTask && j < accessors->size(); j++)
-            entityCounter += (*accessors)[j].entityCount();
+    for (unsigned int i = 0; i < accessors->size(); i++) {
+        (*firstEntityIndices)[i] = entityCounter;
+        entityCounter += (*accessors)[i].entityCount();
     }
-    return m_TaskManager->combine(taskHandles);
+    auto slice = [&execute, accessors, firstEntityIndices](const unsigned int& begin, const unsigned int& end) {
+        return [execute, accessors, firstEntityIndices, begin, end]() {
+            TaskArena& arena = currentWorkerArena();
+            const TaskArena::Marker marker = arena.marker();
+            for (unsigned int i = begin; i < end; i++) {
+                execute((*accessors)[i], i, (*firstEntityIndices)[i]);
+                arena.rewind(marker);
+            }
+        };
+    };
+    std::vector<decltype(slice(0, 0))> slices;
+    for (unsigned int begin = 0; begin < accessors->size(); begin += SystemBase::k_MinChunkCountPerTask)
+        slices.push_back(slice(begin, std::min(begin + SystemBase::k_MinChunkCountPerTask, static_cast<unsigned int>(accessors->size()))));
+    return taskManager->scheduleBatch(std::span(slices), {predecessor}, priority, name);
 }
 
-std::shared_ptr<TaskHandle> SystemBase::schedule(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor) {
-    std::shared_ptr<std::vector<ChunkAccessor>> accessors = std::make_shared<std::vector<ChunkAccessor>>(m_EntityManager->filterEntities(entityFilter));
-    if (accessors->size() == 0) return predecessor;
-    const unsigned int taskCount = std::min(TaskManager::k_WorkerCount, (static_cast<unsigned int>(accessors->size()) - 1) / k_MinChunkCountPerTask + 1);
-    const unsigned int chunkCountPerTask = accessors->size() / taskCount;
-    std::vector<std::shared_ptr<TaskHandle>> taskHandles(taskCount);
-    unsigned int chunkCounter = 0;
-    unsigned int entityCounter = 0;
-    for (unsigned int i = 0; i < taskCount; i++) {
-        EntityCommandBuffer* entityCommandBuffer = m_EntityManager->createEntityCommandBuffer();
-        taskHandles[i] = m_TaskManager->schedule(
-            [entityCommandBufferChunkTask, accessors, chunkCountPerTask, i, chunkCounter, entityCounter, entityCommandBuffer]() {
-                for (unsigned int j = i * chunkCountPerTask; j < (i + 1) * chunkCountPerTask && j < accessors->size(); j++)
-                    entityCommandBufferChunkTask->execute((*accessors)[j], chunkCounter, entityCounter, entityCommandBuffer);
-            },
-            {predecessor});
-        chunkCounter += chunkCountPerTask;
-        for (unsigned int j = i * chunkCountPerTask; j < (i + 1) * chunkCountPerTask && j < accessors->size(); j++)
-            entityCounter += (*accessors)[j].entityCount();
-    }
-    return m_TaskManager->combine(taskHandles);
+}  // namespace
+
+std::shared_ptr<TaskHandle> SystemBase::schedule(std::shared_ptr<ChunkTask> const& chunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    return scheduleChunks(chunkTask, m_EntityManager->filterEntities(entityFilter), predecessor, priority, name);
+}
+
+std::shared_ptr<TaskHandle> SystemBase::schedule(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    return scheduleChunks(entityCommandBufferChunkTask, m_EntityManager->filterEntities(entityFilter), predecessor, priority, name);
+}
+
+std::shared_ptr<TaskHandle> SystemBase::schedule(std::shared_ptr<ChunkTask> const& chunkTask, const EntityQuery* entityQuery, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    return scheduleChunks(chunkTask, m_EntityManager->filterEntities(entityQuery), predecessor, priority, name);
+}
+
+std::shared_ptr<TaskHandle> SystemBase::schedule(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, const EntityQuery* entityQuery, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    return scheduleChunks(entityCommandBufferChunkTask, m_EntityManager->filterEntities(entityQuery), predecessor, priority, name);
+}
+
+std::shared_ptr<TaskHandle> SystemBase::scheduleChunks(std::shared_ptr<ChunkTask> const& chunkTask, std::vector<ChunkAccessor>&& chunkAccessors, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    return scheduleSlices(
+        m_TaskManager, std::move(chunkAccessors),
+        [chunkTask](const ChunkAccessor& chunkAccessor, const unsigned int& chunkIndex, const unsigned int& firstEntityIndex) {
+            chunkTask->execute(chunkAccessor, chunkIndex, firstEntityIndex);
+        },
+        predecessor, priority, name);
+}
+
+std::shared_ptr<TaskHandle> SystemBase::scheduleChunks(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, std::vector<ChunkAccessor>&& chunkAccessors, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name) {
+    if (chunkAccessors.empty()) return predecessor;
+    // Each slice of chunks gets its own EntityCommandBuffer
+    std::shared_ptr<std::vector<EntityCommandBuffer*>> entityCommandBuffers = std::make_shared<std::vector<EntityCommandBuffer*>>((chunkAccessors.size() - 1) / k_MinChunkCountPerTask + 1);
+    for (EntityCommandBuffer*& entityCommandBuffer : *entityCommandBuffers)
+        entityCommandBuffer = m_EntityManager->createEntityCommandBuffer();
+    return scheduleSlices(
+        m_TaskManager, std::move(chunkAccessors),
+        [entityCommandBufferChunkTask, entityCommandBuffers](const ChunkAccessor& chunkAccessor, const unsigned int& chunkIndex, const unsigned int& firstEntityIndex) {
+            entityCommandBufferChunkTask->execute(chunkAccessor, chunkIndex, firstEntityIndex, (*entityCommandBuffers)[chunkIndex / k_MinChunkCountPerTask]);
+        },
+        predecessor, priority, name);
 }
 
 void SystemBase::enter(Instance* instance, TaskManager* taskManager, Time* time, ResourceManager* resourceManager, EntityManager* entityManager, EventManager* eventManager) {
@@ -67,6 +98,9 @@ void SystemBase::update() {
 }
 
 void SystemBase::exit() {
+    // Tasks scheduled in the last update may still read chunks owned by the World
+    if (m_TaskHandle)
+        m_TaskHandle->complete();
     onExit();
 }
 
@@ -3,11 +3,14 @@
 #include <MelonCore/ChunkAccessor.h>
 #include <MelonCore/EntityFilter.h>
 #include <MelonCore/EntityManager.h>
+#include <MelonCore/EntityQuery.h>
 #include <MelonCore/EventManager.h>
 #include <MelonCore/ResourceManager.h>
 #include <MelonCore/Time.h>
+#include <MelonTask/TaskArena.h>
 #include <MelonTask/TaskHandle.h>
 #include <MelonTask/TaskManager.h>
+#include <MelonTask/TaskPriority.h>
 
 #include <memory>
 
@@ -15,6 +18,7 @@ namespace Melon {
 
 class Instance;
 
+// Temporary memory of a chunk could be allocated from currentWorkerArena(), it is released after the chunk is executed
 class ChunkTask {
   public:
     virtual void execute(const ChunkAccessor& chunkAccessor, const unsigned int& chunkIndex, const unsigned int& firstEntityIndex) = 0;
@@ -37,8 +41,10 @@ class SystemBase {
     virtual void onUpdate() = 0;
     virtual void onExit() = 0;
 
-    std::shared_ptr<TaskHandle> schedule(std::shared_ptr<ChunkTask> const& chunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor);
-    std::shared_ptr<TaskHandle> schedule(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor);
+    std::shared_ptr<TaskHandle> schedule(std::shared_ptr<ChunkTask> const& chunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    std::shared_ptr<TaskHandle> schedule(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, const EntityFilter& entityFilter, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    std::shared_ptr<TaskHandle> schedule(std::shared_ptr<ChunkTask> const& chunkTask, const EntityQuery* entityQuery, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    std::shared_ptr<TaskHandle> schedule(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, const EntityQuery* entityQuery, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
 
     Instance* const& instance() const { return m_Instance; }
     TaskManager* const& taskManager() const { return m_TaskManager; }
@@ -51,6 +57,9 @@ class SystemBase {
     std::shared_ptr<TaskHandle>& predecessor() { return m_TaskHandle; }
 
   private:
+    std::shared_ptr<TaskHandle> scheduleChunks(std::shared_ptr<ChunkTask> const& chunkTask, std::vector<ChunkAccessor>&& chunkAccessors, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name);
+    std::shared_ptr<TaskHandle> scheduleChunks(std::shared_ptr<EntityCommandBufferChunkTask> const& entityCommandBufferChunkTask, std::vector<ChunkAccessor>&& chunkAccessors, std::shared_ptr<TaskHandle> const& predecessor, const TaskPriority& priority, const char* name);
+
     void enter(Instance* instance, TaskManager* taskManager, Time* time, ResourceManager* resourceManager, EntityManager* entityManager, EventManager* eventManager);
     void update();
     void exit();
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+
+namespace Melon {
+
+// Process-wide ids of types, each type takes its id once on first use
+// Each family such as DataComponent has its own dense ids from zero
+template <typename Family>
+class TypeId {
+  public:
+    // Qualifiers are ignored like typeid does, so a const component shares the id of its type
+    template <typename Type>
+    static unsigned int of() { return unqualifiedOf<std::remove_cv_t<Type>>(); }
+
+  private:
+    template <typename Type>
+    static unsigned int unqualifiedOf() {
+        static const unsigned int id = next();
+        return id;
+    }
+
+    static unsigned int next() {
+        static std::atomic<unsigned int> counter{};
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+}  // namespace Melon
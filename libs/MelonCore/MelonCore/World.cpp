@@ -5,11 +5,11 @@
 
 namespace Melon {
 
-World::World(TaskManager* taskManager) : m_TaskManager(taskManager) {
+World::World(TaskManager* taskManager) : m_TaskManager(taskManager), m_TaskGraph(taskManager) {
     EntityManager* entityManager = &m_EntityManager;
-    m_EntityCommandBufferExecutor = [entityManager]() {
-        entityManager->executeEntityCommandBuffers();
-    };
+    m_TaskGraph.record(
+        [entityManager]() { entityManager->executeEntityCommandBuffers(); },
+        {}, TaskPriority::Normal, "EntityCommandBufferExecutor");
 }
 
 void World::enter(Instance* instance, Time* time, ResourceManager* resourceManager) {
@@ -18,12 +18,11 @@ void World::enter(Instance* instance, Time* time, ResourceManager* resourceManag
 }
 
 void World::update() {
-    // Schedule entity command buffer executor
-    std::vector<std::shared_ptr<TaskHandle>> predecessors(m_Systems.size());
+    // Replay entity command buffer executor
+    m_SystemPredecessors.resize(m_Systems.size());
     for (unsigned int i = 0; i < m_Systems.size(); i++)
-        predecessors[i] = m_Systems[i]->predecessor();
-    std::shared_ptr<TaskHandle> taskHandle = m_TaskManager->schedule(m_EntityCommandBufferExecutor, predecessors);
-    m_TaskManager->activateWaitingTasks();
+        m_SystemPredecessors[i] = m_Systems[i]->predecessor();
+    std::shared_ptr<TaskHandle> const& taskHandle = m_TaskGraph.run(m_SystemPredecessors);
     for (std::unique_ptr<SystemBase> const& system : m_Systems)
         system->predecessor() = taskHandle;
     // Update systems
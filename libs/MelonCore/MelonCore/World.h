@@ -3,10 +3,10 @@
 #include <MelonCore/ResourceManager.h>
 #include <MelonCore/SystemBase.h>
 #include <MelonCore/Time.h>
+#include <MelonTask/TaskGraph.h>
 #include <MelonTask/TaskManager.h>
 #include <MelonCore/EventManager.h>
 
-#include <functional>
 #include <memory>
 #include <vector>
 
@@ -32,7 +32,9 @@ class World {
     EntityManager m_EntityManager;
     EventManager m_EventManager;
     std::vector<std::unique_ptr<SystemBase>> m_Systems;
-    std::function<void()> m_EntityCommandBufferExecutor;
+    std::vector<std::shared_ptr<TaskHandle>> m_SystemPredecessors;
+    // Recorded with the entity command buffer executor, replayed each frame after all systems
+    TaskGraph m_TaskGraph;
 };
 
 template <typename Type, typename... Args>
@@ -41,9 +41,9 @@ class RenderTask : public ChunkTask {
     RenderTask(std::vector<glm::mat4>& models, std::vector<const ManualRenderMesh*>& manualRenderMeshes, const unsigned int& translationComponentId, const unsigned int& rotationComponentId, const unsigned int& scaleComponentId, const unsigned int& manualRenderMeshComponentId) : m_Models(models), m_ManualRenderMeshes(manualRenderMeshes), m_TranslationComponentId(translationComponentId), m_RotationComponentId(rotationComponentId), m_ScaleComponentId(scaleComponentId), m_ManualRenderMeshComponentId(manualRenderMeshComponentId){};
 
     virtual void execute(const ChunkAccessor& chunkAccessor, const unsigned int& chunkIndex, const unsigned int& firstEntityIndex) override {
-        Translation* translations = chunkAccessor.componentArray<Translation>(m_TranslationComponentId);
-        Rotation* rotations = chunkAccessor.componentArray<Rotation>(m_RotationComponentId);
-        Scale* scales = chunkAccessor.componentArray<Scale>(m_ScaleComponentId);
+        const Translation* translations = chunkAccessor.componentArray<const Translation>(m_TranslationComponentId);
+        const Rotation* rotations = chunkAccessor.componentArray<const Rotation>(m_RotationComponentId);
+        const Scale* scales = chunkAccessor.componentArray<const Scale>(m_ScaleComponentId);
         const ManualRenderMesh* manualRenderMesh = chunkAccessor.sharedComponent<ManualRenderMesh>(m_ManualRenderMeshComponentId);
         for (unsigned int i = 0; i < chunkAccessor.entityCount(); i++) {
             glm::mat4 model = glm::scale(glm::mat4(1.0f), scales[i].value);
@@ -87,11 +87,11 @@ RenderSystem::~RenderSystem() {}
 void RenderSystem::onEnter() {
     m_Engine.initialize(taskManager(), instance()->applicationName().c_str(), m_CurrentWidth, m_CurrentHeight);
 
-    m_CreatedRenderMeshEntityFilter = entityManager()->createEntityFilterBuilder().requireSharedComponents<RenderMesh>().rejectSharedComponents<ManualRenderMesh>().createEntityFilter();
-    m_RenderMeshEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<Translation, Rotation, Scale>().requireSharedComponents<RenderMesh, ManualRenderMesh>().createEntityFilter();
-    m_DestroyedRenderMeshEntityFilter = entityManager()->createEntityFilterBuilder().requireSharedComponents<ManualRenderMesh>().rejectSharedComponents<RenderMesh>().createEntityFilter();
-    m_CameraEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<Translation, Rotation, Camera, PerspectiveProjection>().createEntityFilter();
-    m_LightEntityFilter = entityManager()->createEntityFilterBuilder().requireComponents<Light>().createEntityFilter();
+    m_CreatedRenderMeshEntityQuery = entityManager()->createEntityFilterBuilder().requireSharedComponents<RenderMesh>().rejectSharedComponents<ManualRenderMesh>().createEntityQuery();
+    m_RenderMeshEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<Translation, Rotation, Scale>().requireSharedComponents<RenderMesh, ManualRenderMesh>().createEntityQuery();
+    m_DestroyedRenderMeshEntityQuery = entityManager()->createEntityFilterBuilder().requireSharedComponents<ManualRenderMesh>().rejectSharedComponents<RenderMesh>().createEntityQuery();
+    m_CameraEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<Translation, Rotation, Camera, PerspectiveProjection>().createEntityQuery();
+    m_LightEntityQuery = entityManager()->createEntityFilterBuilder().requireComponents<Light>().createEntityQuery();
 
     m_TranslationComponentId = entityManager()->componentId<Translation>();
     m_RotationComponentId = entityManager()->componentId<Rotation>();
@@ -110,46 +110,47 @@ void RenderSystem::onEnter() {
 
 void RenderSystem::onUpdate() {
     // CreatedRenderMeshTask
-    const unsigned int createdRenderMeshCount = entityManager()->entityCount(m_CreatedRenderMeshEntityFilter);
+    const unsigned int createdRenderMeshCount = entityManager()->entityCount(m_CreatedRenderMeshEntityQuery);
     std::vector<Entity> createdRenderMeshEntities(createdRenderMeshCount);
     std::vector<unsigned int> createdRenderMeshIndices(createdRenderMeshCount);
-    std::shared_ptr<TaskHandle> createdRenderMeshTaskHandle = schedule(std::make_shared<CreatedRenderMeshTask>(m_RenderMeshComponentId, createdRenderMeshEntities, createdRenderMeshIndices), m_CreatedRenderMeshEntityFilter, predecessor());
+    std::shared_ptr<TaskHandle> createdRenderMeshTaskHandle = schedule(std::make_shared<CreatedRenderMeshTask>(m_RenderMeshComponentId, createdRenderMeshEntities, createdRenderMeshIndices), m_CreatedRenderMeshEntityQuery, predecessor(), TaskPriority::Critical, "CreatedRenderMeshTask");
 
     // DestroyedRenderMeshTask
-    const unsigned int destroyedRenderMeshCount = entityManager()->entityCount(m_DestroyedRenderMeshEntityFilter);
+    const unsigned int destroyedRenderMeshCount = entityManager()->entityCount(m_DestroyedRenderMeshEntityQuery);
     std::vector<Entity> manualRenderMeshEntities(destroyedRenderMeshCount);
     std::vector<unsigned int> manualRenderMeshIndices(destroyedRenderMeshCount);
-    std::shared_ptr<TaskHandle> destroyedRenderMeshTaskHandle = schedule(std::make_shared<DestroyedRenderMeshTask>(m_ManualRenderMeshComponentId, manualRenderMeshEntities, manualRenderMeshIndices), m_DestroyedRenderMeshEntityFilter, predecessor());
+    std::shared_ptr<TaskHandle> destroyedRenderMeshTaskHandle = schedule(std::make_shared<DestroyedRenderMeshTask>(m_ManualRenderMeshComponentId, manualRenderMeshEntities, manualRenderMeshIndices), m_DestroyedRenderMeshEntityQuery, predecessor(), TaskPriority::Critical, "DestroyedRenderMeshTask");
 
     // RenderTask
-    const unsigned int renderMeshCount = entityManager()->entityCount(m_RenderMeshEntityFilter);
-    std::vector<glm::mat4> models(renderMeshCount);
-    std::vector<const ManualRenderMesh*> manualRenderMeshes(renderMeshCount);
-    std::shared_ptr<TaskHandle> renderMeshTaskHandle = schedule(std::make_shared<RenderTask>(models, manualRenderMeshes, m_TranslationComponentId, m_RotationComponentId, m_ScaleComponentId, m_ManualRenderMeshComponentId), m_RenderMeshEntityFilter, predecessor());
+    const unsigned int renderMeshCount = entityManager()->entityCount(m_RenderMeshEntityQuery);
+    // Read by the RenderFrame task after onUpdate returns
+    std::shared_ptr<std::vector<glm::mat4>> models = std::make_shared<std::vector<glm::mat4>>(renderMeshCount);
+    std::shared_ptr<std::vector<const ManualRenderMesh*>> manualRenderMeshes = std::make_shared<std::vector<const ManualRenderMesh*>>(renderMeshCount);
+    std::shared_ptr<TaskHandle> renderMeshTaskHandle = schedule(std::make_shared<RenderTask>(*models, *manualRenderMeshes, m_TranslationComponentId, m_RotationComponentId, m_ScaleComponentId, m_ManualRenderMeshComponentId), m_RenderMeshEntityQuery, predecessor(), TaskPriority::Critical, "RenderTask");
 
     taskManager()->activateWaitingTasks();
 
     // Fetch components of a Camera. If not found, use a default Camera
-    std::vector<ChunkAccessor> accessors = entityManager()->filterEntities(m_CameraEntityFilter);
+    std::vector<ChunkAccessor> accessors = entityManager()->filterEntities(m_CameraEntityQuery);
     glm::vec3 cameraTranslation(0.0f, 0.0f, 0.0f);
     glm::quat cameraRotation = glm::quatLookAt(glm::normalize(glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(0.0f, 0.0f, 1.0f));
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), m_Engine.windowAspectRatio(), 0.1f, 10.0f);
     projection[1][1] *= -1;
     for (auto accessor : accessors)
         for (unsigned int i = 0; i < accessor.entityCount(); i++) {
-            cameraTranslation = accessor.componentArray<Translation>(m_TranslationComponentId)[i].value;
-            cameraRotation = accessor.componentArray<Rotation>(m_RotationComponentId)[i].value;
-            PerspectiveProjection perspectiveProjection = accessor.componentArray<PerspectiveProjection>(m_PerspectiveProjectionComponentId)[i];
+            cameraTranslation = accessor.componentArray<const Translation>(m_TranslationComponentId)[i].value;
+            cameraRotation = accessor.componentArray<const Rotation>(m_RotationComponentId)[i].value;
+            PerspectiveProjection perspectiveProjection = accessor.componentArray<const PerspectiveProjection>(m_PerspectiveProjectionComponentId)[i];
             projection = glm::perspective(glm::radians(perspectiveProjection.fovy), m_Engine.windowAspectRatio(), perspectiveProjection.zNear, perspectiveProjection.zFar);
             projection[1][1] *= -1;
         }
 
     // Fetch a Light
-    accessors = entityManager()->filterEntities(m_LightEntityFilter);
+    accessors = entityManager()->filterEntities(m_LightEntityQuery);
     glm::vec3 lightDirection(0.0f, 0.0f, 0.0f);
     for (auto accessor : accessors)
         for (unsigned int i = 0; i < accessor.entityCount(); i++)
-            lightDirection = accessor.componentArray<Light>(m_LightComponentId)[i].direction;
+            lightDirection = accessor.componentArray<const Light>(m_LightComponentId)[i].direction;
 
     m_Engine.beginFrame();
 
@@ -182,22 +183,26 @@ void RenderSystem::onUpdate() {
         entityManager()->removeSharedComponent<ManualRenderMesh>(manualRenderMeshEntities[i]);
     }
 
-    // Add batches
-    renderMeshTaskHandle->complete();
-    m_Engine.beginBatches();
-    std::vector<glm::mat4> batchModels;
-    for (unsigned int i = 0; i < renderMeshCount; i++) {
-        batchModels.push_back(models[i]);
-        while (i + 1 < renderMeshCount && manualRenderMeshes[i] == manualRenderMeshes[i + 1]) batchModels.push_back(models[++i]);
-        m_Engine.addBatch(batchModels, manualRenderMeshes[i]->meshBuffer);
-        batchModels.clear();
-    }
-    m_Engine.endBatches();
-
-    // Draw frame
-    m_Engine.renderFrame(projection, cameraTranslation, cameraRotation, lightDirection);
+    // Add batches and draw the frame on the main thread once RenderTask is finished, without blocking other systems
+    // The next frame begins after it, because SystemBase completes the predecessor before onUpdate
+    predecessor() = taskManager()->scheduleOnMainThread(
+        [this, models, manualRenderMeshes, renderMeshCount, projection, cameraTranslation, cameraRotation, lightDirection]() {
+            m_Engine.beginBatches();
+            std::vector<glm::mat4> batchModels;
+            for (unsigned int i = 0; i < renderMeshCount; i++) {
+                batchModels.push_back((*models)[i]);
+                while (i + 1 < renderMeshCount && (*manualRenderMeshes)[i] == (*manualRenderMeshes)[i + 1]) batchModels.push_back((*models)[++i]);
+                m_Engine.addBatch(batchModels, (*manualRenderMeshes)[i]->meshBuffer);
+                batchModels.clear();
+            }
+            m_Engine.endBatches();
+
+            m_Engine.renderFrame(projection, cameraTranslation, cameraRotation, lightDirection);
+
+            m_Engine.endFrame();
+        },
+        {renderMeshTaskHandle}, "RenderFrame");
 
-    m_Engine.endFrame();
     if (m_Engine.windowClosed())
         instance()->quit();
 
@@ -210,6 +215,8 @@ void RenderSystem::onUpdate() {
 }
 
 void RenderSystem::onExit() {
+    if (predecessor())
+        predecessor()->complete();
     for (const auto& [index, meshBuffer] : m_MeshBufferMap)
         m_Engine.destroyMeshBuffer(meshBuffer);
     m_Engine.terminate();
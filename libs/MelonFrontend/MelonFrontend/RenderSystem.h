@@ -25,11 +25,11 @@ class RenderSystem : public SystemBase {
   private:
     Engine m_Engine;
 
-    EntityFilter m_CreatedRenderMeshEntityFilter;
-    EntityFilter m_RenderMeshEntityFilter;
-    EntityFilter m_DestroyedRenderMeshEntityFilter;
-    EntityFilter m_CameraEntityFilter;
-    EntityFilter m_LightEntityFilter;
+    EntityQuery* m_CreatedRenderMeshEntityQuery;
+    EntityQuery* m_RenderMeshEntityQuery;
+    EntityQuery* m_DestroyedRenderMeshEntityQuery;
+    EntityQuery* m_CameraEntityQuery;
+    EntityQuery* m_LightEntityQuery;
 
     unsigned int m_TranslationComponentId;
     unsigned int m_RotationComponentId;
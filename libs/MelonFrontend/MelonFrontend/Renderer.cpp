@@ -28,8 +28,9 @@ void Renderer::initialize(TaskManager* taskManager, Window* window) {
     m_SwapChain.initialize(window->extent(), m_Surface, m_PhysicalDevice, m_Device, m_GraphicsQueueFamilyIndex, m_PresentQueueFamilyIndex, m_PresentQueue);
 
     createCommandPool(m_Device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_GraphicsQueueFamilyIndex, m_CommandPool);
-    for (unsigned int i = 0; i < k_MaxTaskCount; i++)
-        createCommandPool(m_Device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_GraphicsQueueFamilyIndex, m_CommandPools[i]);
+    m_CommandPools.resize(m_TaskManager->workerCount() + 1);
+    for (VkCommandPool& commandPool : m_CommandPools)
+        createCommandPool(m_Device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_GraphicsQueueFamilyIndex, commandPool);
     createRenderPass(m_PhysicalDevice, m_Device, m_SwapChain.imageFormat(), m_RenderPassClear);
     selectDepthFormat(m_PhysicalDevice, m_DepthMap.format);
     m_DepthMap.extent = m_SwapChain.imageExtent();
@@ -105,8 +106,8 @@ void Renderer::terminate() {
     vkDestroyImageView(m_Device, m_DepthMap.imageView, nullptr);
     vmaDestroyImage(m_Allocator, m_DepthMap.image, m_DepthMap.allocation);
     vkDestroyRenderPass(m_Device, m_RenderPassClear, nullptr);
-    for (unsigned int i = 0; i < k_MaxTaskCount; i++)
-        vkDestroyCommandPool(m_Device, m_CommandPools[i], nullptr);
+    for (VkCommandPool commandPool : m_CommandPools)
+        vkDestroyCommandPool(m_Device, commandPool, nullptr);
     vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
 
     m_SwapChain.terminate();
@@ -266,40 +267,41 @@ void Renderer::recordCommandBufferCopyUniformObject(VkDeviceSize size, UniformBu
 }
 
 void Renderer::recordCommandBufferDraw(std::vector<RenderBatch> const& renderBatches, const UniformBuffer& cameraUniformBuffer, const UniformBuffer& lightUniformBuffer) {
-    uint32_t taskCount = std::min(k_MaxTaskCount, static_cast<unsigned int>(renderBatches.size()));
-    m_SecondaryCommandBufferArrays[m_CurrentFrame].resize(taskCount);
-    unsigned int batchCountPerTask = taskCount == 0 ? 0 : (renderBatches.size() / taskCount + ((renderBatches.size() % taskCount == 0) ? 0 : 1));
-
-    std::vector<std::shared_ptr<TaskHandle>> subrendererHandles(taskCount);
-    for (uint32_t i = 0; i < taskCount; i++) {
-        VkDevice device = m_Device;
-        VkFramebuffer framebuffer = m_Framebuffers[m_CurrentImageIndex];
-        VkRenderPass renderPass = m_RenderPassClear;
-        SecondaryCommandBuffer* secondaryCommandBuffer = &m_SecondaryCommandBufferArrays[m_CurrentFrame][i];
-        secondaryCommandBuffer->pool = m_CommandPools[i];
-        Subrenderer* subrenderer = m_Subrenderer.get();
-        unsigned int swapChainImageIndex = m_CurrentImageIndex;
-        subrendererHandles[i] = m_TaskManager->schedule(
-            [device, framebuffer, renderPass, secondaryCommandBuffer, subrenderer, swapChainImageIndex, i, &cameraUniformBuffer, &lightUniformBuffer, &renderBatches, batchCountPerTask]() {
-                allocateCommandBuffer(device, secondaryCommandBuffer->pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1, secondaryCommandBuffer->buffer);
-                VkCommandBufferInheritanceInfo inheritanceInfo{
-                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
-                    .renderPass = renderPass,
-                    .subpass = 0,
-                    .framebuffer = framebuffer};
-                VkCommandBufferBeginInfo beginInfo{
-                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                    .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
-                    .pInheritanceInfo = &inheritanceInfo};
-                vkBeginCommandBuffer(secondaryCommandBuffer->buffer, &beginInfo);
-                for (unsigned int j = 0; j < batchCountPerTask && batchCountPerTask * i + j < renderBatches.size(); j++)
-                    subrenderer->draw(secondaryCommandBuffer->buffer, swapChainImageIndex, cameraUniformBuffer.descriptorSet, lightUniformBuffer.descriptorSet, renderBatches[batchCountPerTask * i + j]);
-                vkEndCommandBuffer(secondaryCommandBuffer->buffer);
-            });
-    }
+    // Each block of batches is recorded to a secondary command buffer allocated from the pool of the executing thread
+    const unsigned int batchCount = static_cast<unsigned int>(renderBatches.size());
+    m_SecondaryCommandBufferArrays[m_CurrentFrame].resize(batchCount == 0 ? 0 : (batchCount - 1) / k_MinBatchCountPerTask + 1);
+
+    VkDevice device = m_Device;
+    VkFramebuffer framebuffer = m_Framebuffers[m_CurrentImageIndex];
+    VkRenderPass renderPass = m_RenderPassClear;
+    std::vector<SecondaryCommandBuffer>* secondaryCommandBuffers = &m_SecondaryCommandBufferArrays[m_CurrentFrame];
+    std::vector<VkCommandPool> const* commandPools = &m_CommandPools;
+    TaskManager* taskManager = m_TaskManager;
+    Subrenderer* subrenderer = m_Subrenderer.get();
+    unsigned int swapChainImageIndex = m_CurrentImageIndex;
+    std::shared_ptr<TaskHandle> subrendererHandle = m_TaskManager->parallelFor(
+        0, batchCount, k_MinBatchCountPerTask,
+        [device, framebuffer, renderPass, secondaryCommandBuffers, commandPools, taskManager, subrenderer, swapChainImageIndex, &cameraUniformBuffer, &lightUniformBuffer, &renderBatches](const unsigned int& begin, const unsigned int& end) {
+            SecondaryCommandBuffer& secondaryCommandBuffer = (*secondaryCommandBuffers)[begin / k_MinBatchCountPerTask];
+            secondaryCommandBuffer.pool = (*commandPools)[taskManager->currentThreadIndex()];
+            allocateCommandBuffer(device, secondaryCommandBuffer.pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1, secondaryCommandBuffer.buffer);
+            VkCommandBufferInheritanceInfo inheritanceInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+                .renderPass = renderPass,
+                .subpass = 0,
+                .framebuffer = framebuffer};
+            VkCommandBufferBeginInfo beginInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                .pInheritanceInfo = &inheritanceInfo};
+            vkBeginCommandBuffer(secondaryCommandBuffer.buffer, &beginInfo);
+            for (unsigned int i = begin; i < end; i++)
+                subrenderer->draw(secondaryCommandBuffer.buffer, swapChainImageIndex, cameraUniformBuffer.descriptorSet, lightUniformBuffer.descriptorSet, renderBatches[i]);
+            vkEndCommandBuffer(secondaryCommandBuffer.buffer);
+        },
+        TaskPriority::Critical, "RecordCommandBufferDraw");
     m_TaskManager->activateWaitingTasks();
-    for (std::shared_ptr<TaskHandle> taskHandle : subrendererHandles)
-        taskHandle->complete();
+    subrendererHandle->complete();
 
     std::array<VkClearValue, 2> clearValues = {
         VkClearValue{.color = {0.0f, 0.0f, 0.0f, 1.0f}},
@@ -30,7 +30,7 @@ struct SwapchainImageContext;
 class Renderer {
   public:
     static constexpr unsigned int k_MaxInFlightFrameCount = 2U;
-    static constexpr unsigned int k_MaxTaskCount = 4U;
+    static constexpr unsigned int k_MinBatchCountPerTask = 4U;
     static constexpr unsigned int k_MaxUniformDescriptorCount = 2048U;
 
     void initialize(TaskManager* taskManager, Window* window);
@@ -73,7 +73,8 @@ class Renderer {
 
     SwapChain m_SwapChain;
     VkCommandPool m_CommandPool;
-    VkCommandPool m_CommandPools[k_MaxTaskCount];
+    // One per thread of the TaskManager, indexed by TaskManager::currentThreadIndex()
+    std::vector<VkCommandPool> m_CommandPools;
     uint32_t m_CurrentImageIndex;
 
     VkRenderPass m_RenderPassClear;
@@ -0,0 +1,53 @@
+#include <MelonTask/Task.h>
+#include <MelonTask/TaskAllocator.h>
+
+#include <exception>
+#include <new>
+
+namespace Melon {
+
+void* TaskPromiseBase::operator new(std::size_t size) {
+    if (size <= TaskMemoryPool::k_BlockSize)
+        return TaskMemoryPool::allocate();
+    return ::operator new(size);
+}
+
+void TaskPromiseBase::operator delete(void* frame, std::size_t size) {
+    if (size <= TaskMemoryPool::k_BlockSize)
+        TaskMemoryPool::deallocate(frame);
+    else
+        ::operator delete(frame);
+}
+
+void TaskPromiseBase::unhandled_exception() noexcept {
+    std::terminate();
+}
+
+std::shared_ptr<TaskHandle> TaskPromiseBase::start(std::coroutine_handle<> coroutine, TaskManager* taskManager, const TaskPriority& priority, const char* name) {
+    m_TaskManager = taskManager;
+    m_Priority = priority;
+    m_Completion = taskManager->createTask(nullptr, priority);
+    // The coroutine may return on a worker before spawn returns
+    std::shared_ptr<TaskHandle> completion = m_Completion;
+    taskManager->spawn([coroutine]() { coroutine.resume(); }, priority, name);
+    return completion;
+}
+
+std::coroutine_handle<> TaskPromiseBase::finish() noexcept {
+    if (m_Continuation)
+        return m_Continuation;
+    if (m_Completion) {
+        // The frame may be destroyed once the completion is finished, so hold it outside the frame
+        std::shared_ptr<TaskHandle> completion = m_Completion;
+        completion->notifyFinished();
+    }
+    return std::noop_coroutine();
+}
+
+void TaskHandleAwaiter::resumeAfterFinished(std::coroutine_handle<> coroutine, const TaskPriority& priority) {
+    // The awaiter lives in the frame, which may be resumed and destroyed on a worker before spawn returns
+    std::shared_ptr<TaskHandle> taskHandle = m_TaskHandle;
+    taskHandle->m_TaskManager->spawn([coroutine]() { coroutine.resume(); }, {taskHandle}, priority);
+}
+
+}  // namespace Melon
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <MelonTask/TaskHandle.h>
+#include <MelonTask/TaskManager.h>
+#include <MelonTask/TaskPriority.h>
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace Melon {
+
+template <typename Type = void>
+class Task;
+
+// State shared by promises of all Task types
+class TaskPromiseBase {
+  public:
+    // Small coroutine frames are allocated from the TaskMemoryPool
+    static void* operator new(std::size_t size);
+    static void operator delete(void* frame, std::size_t size);
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept { return FinalAwaiter{}; }
+    // Exceptions are not used by MelonTask
+    void unhandled_exception() noexcept;
+
+  private:
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> coroutine) noexcept { return coroutine.promise().finish(); }
+        void await_resume() noexcept {}
+    };
+
+    std::shared_ptr<TaskHandle> start(std::coroutine_handle<> coroutine, TaskManager* taskManager, const TaskPriority& priority, const char* name);
+    // Resume the awaiting coroutine, or finish the TaskHandle returned by start
+    std::coroutine_handle<> finish() noexcept;
+
+    TaskManager* m_TaskManager{};
+    TaskPriority m_Priority{TaskPriority::Normal};
+    std::coroutine_handle<> m_Continuation;
+    std::shared_ptr<TaskHandle> m_Completion;
+
+    template <typename>
+    friend class Task;
+    friend class TaskHandleAwaiter;
+};
+
+template <typename Type>
+class TaskPromise : public TaskPromiseBase {
+  public:
+    Task<Type> get_return_object() noexcept;
+    template <typename Value>
+    void return_value(Value&& value) { m_Result.emplace(std::forward<Value>(value)); }
+
+  private:
+    std::optional<Type> m_Result;
+
+    friend class Task<Type>;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+  public:
+    Task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+};
+
+// Coroutine which runs on workers of a TaskManager
+// It is lazy, and runs after it is started or awaited by another coroutine
+template <typename Type>
+class Task {
+  public:
+    using promise_type = TaskPromise<Type>;
+
+    Task(Task&& other) noexcept : m_Coroutine(std::exchange(other.m_Coroutine, {})) {}
+    Task(const Task&) = delete;
+    ~Task();
+
+    // Resume the coroutine on a worker, the returned TaskHandle is finished when the coroutine returns
+    // The Task should be kept alive until then
+    std::shared_ptr<TaskHandle> start(TaskManager* taskManager, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    // Only valid after the coroutine returns
+    std::add_lvalue_reference_t<Type> result() requires(!std::is_void_v<Type>) { return *m_Coroutine.promise().m_Result; }
+
+    // The awaited Task runs on the awaiting thread at once, and inherits the TaskManager and priority
+    auto operator co_await() noexcept { return Awaiter{m_Coroutine}; }
+
+  private:
+    struct Awaiter {
+        std::coroutine_handle<promise_type> coroutine;
+
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> awaiting) noexcept;
+        Type await_resume();
+    };
+
+    explicit Task(std::coroutine_handle<promise_type> coroutine) : m_Coroutine(coroutine) {}
+
+    std::coroutine_handle<promise_type> m_Coroutine;
+
+    friend class TaskPromise<Type>;
+};
+
+// Awaiting a TaskHandle suspends the coroutine without blocking the thread, it is resumed on a worker after the TaskHandle is finished
+class TaskHandleAwaiter {
+  public:
+    TaskHandleAwaiter(std::shared_ptr<TaskHandle> const& taskHandle) : m_TaskHandle(taskHandle) {}
+
+    bool await_ready() const { return !m_TaskHandle || m_TaskHandle->finished(); }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> coroutine);
+    void await_resume() const {}
+
+  private:
+    void resumeAfterFinished(std::coroutine_handle<> coroutine, const TaskPriority& priority);
+
+    std::shared_ptr<TaskHandle> m_TaskHandle;
+};
+
+inline TaskHandleAwaiter operator co_await(std::shared_ptr<TaskHandle> const& taskHandle) {
+    return TaskHandleAwaiter(taskHandle);
+}
+
+template <typename Type>
+inline Task<Type> TaskPromise<Type>::get_return_object() noexcept {
+    return Task<Type>(std::coroutine_handle<TaskPromise<Type>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+template <typename Type>
+inline Task<Type>::~Task() {
+    if (m_Coroutine)
+        m_Coroutine.destroy();
+}
+
+template <typename Type>
+inline std::shared_ptr<TaskHandle> Task<Type>::start(TaskManager* taskManager, const TaskPriority& priority, const char* name) {
+    assert(m_Coroutine && !m_Coroutine.promise().m_Completion && !m_Coroutine.promise().m_Continuation);
+    return m_Coroutine.promise().start(m_Coroutine, taskManager, priority, name);
+}
+
+template <typename Type>
+template <typename Promise>
+inline std::coroutine_handle<> Task<Type>::Awaiter::await_suspend(std::coroutine_handle<Promise> awaiting) noexcept {
+    TaskPromise<Type>& promise = coroutine.promise();
+    promise.m_Continuation = awaiting;
+    if constexpr (std::is_base_of_v<TaskPromiseBase, Promise>) {
+        promise.m_TaskManager = awaiting.promise().m_TaskManager;
+        promise.m_Priority = awaiting.promise().m_Priority;
+    }
+    return coroutine;
+}
+
+template <typename Type>
+inline Type Task<Type>::Awaiter::await_resume() {
+    if constexpr (!std::is_void_v<Type>)
+        return std::move(*coroutine.promise().m_Result);
+}
+
+template <typename Promise>
+inline void TaskHandleAwaiter::await_suspend(std::coroutine_handle<Promise> coroutine) {
+    if constexpr (std::is_base_of_v<TaskPromiseBase, Promise>)
+        resumeAfterFinished(coroutine, coroutine.promise().m_Priority);
+    else
+        resumeAfterFinished(coroutine, TaskPriority::Normal);
+}
+
+}  // namespace Melon
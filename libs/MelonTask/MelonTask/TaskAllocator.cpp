@@ -0,0 +1,90 @@
+#include <MelonTask/TaskAllocator.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Melon {
+
+namespace {
+
+struct Block {
+    alignas(TaskMemoryPool::k_BlockAlign) std::byte memory[TaskMemoryPool::k_BlockSize];
+};
+
+class GlobalBlockStore {
+  public:
+    // Take a batch of free blocks, create new blocks if there is no free batch
+    std::vector<void*> acquireBatch() {
+        std::lock_guard lock(m_Mutex);
+        if (!m_FreeBatches.empty()) {
+            std::vector<void*> batch = std::move(m_FreeBatches.back());
+            m_FreeBatches.pop_back();
+            return batch;
+        }
+        Block* blocks = m_BlockArrays.emplace_back(std::make_unique<Block[]>(TaskMemoryPool::k_BatchBlockCount)).get();
+        std::vector<void*> batch(TaskMemoryPool::k_BatchBlockCount);
+        for (unsigned int i = 0; i < TaskMemoryPool::k_BatchBlockCount; i++)
+            batch[i] = &blocks[i];
+        return batch;
+    }
+
+    void releaseBatch(std::vector<void*>&& batch) {
+        std::lock_guard lock(m_Mutex);
+        m_FreeBatches.emplace_back(std::move(batch));
+    }
+
+  private:
+    std::mutex m_Mutex;
+    std::vector<std::vector<void*>> m_FreeBatches;
+    std::vector<std::unique_ptr<Block[]>> m_BlockArrays;
+};
+
+GlobalBlockStore& globalBlockStore() {
+    // Never destroyed, because TaskHandles may be released after static destruction
+    static GlobalBlockStore* store = new GlobalBlockStore;
+    return *store;
+}
+
+class LocalBlockCache {
+  public:
+    ~LocalBlockCache() {
+        if (!m_FreeBlocks.empty())
+            globalBlockStore().releaseBatch(std::move(m_FreeBlocks));
+    }
+
+    void* allocate() {
+        if (m_FreeBlocks.empty())
+            m_FreeBlocks = globalBlockStore().acquireBatch();
+        void* block = m_FreeBlocks.back();
+        m_FreeBlocks.pop_back();
+        return block;
+    }
+
+    void deallocate(void* block) {
+        m_FreeBlocks.push_back(block);
+        // Blocks freed by workers are mostly requested by the main thread, so give a batch back
+        if (m_FreeBlocks.size() >= 2 * TaskMemoryPool::k_BatchBlockCount) {
+            std::vector<void*> batch(m_FreeBlocks.end() - TaskMemoryPool::k_BatchBlockCount, m_FreeBlocks.end());
+            m_FreeBlocks.resize(m_FreeBlocks.size() - TaskMemoryPool::k_BatchBlockCount);
+            globalBlockStore().releaseBatch(std::move(batch));
+        }
+    }
+
+  private:
+    std::vector<void*> m_FreeBlocks;
+};
+
+thread_local LocalBlockCache t_LocalBlockCache;
+
+}  // namespace
+
+void* TaskMemoryPool::allocate() {
+    return t_LocalBlockCache.allocate();
+}
+
+void TaskMemoryPool::deallocate(void* block) {
+    t_LocalBlockCache.deallocate(block);
+}
+
+}  // namespace Melon
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace Melon {
+
+// Fixed size memory blocks shared by all TaskManagers
+// Freed blocks are cached by the freeing thread, and exchanged with other threads in batches
+class TaskMemoryPool {
+  public:
+#ifdef MELON_TASK_TRACING
+    // Room for the name and the queued time each TaskHandle records
+    static constexpr std::size_t k_BlockSize = 256 + sizeof(const char*) + sizeof(std::uint64_t);
+#else
+    static constexpr std::size_t k_BlockSize = 256;
+#endif
+    static constexpr std::size_t k_BlockAlign = alignof(std::max_align_t);
+    // Control block placed before the object by allocate_shared, a vtable pointer and the two reference counts
+    static constexpr std::size_t k_ControlBlockSize = sizeof(void*) + 2 * sizeof(int);
+    static constexpr unsigned int k_BatchBlockCount = 64;
+
+    static void* allocate();
+    static void deallocate(void* block);
+};
+
+// Allocator used to create TaskHandles with the control block of shared_ptr in a single pooled block
+template <typename Type>
+class TaskAllocator {
+  public:
+    using value_type = Type;
+
+    TaskAllocator() noexcept {}
+    template <typename Other>
+    TaskAllocator(const TaskAllocator<Other>&) noexcept {}
+
+    Type* allocate(const std::size_t& count);
+    void deallocate(Type* object, const std::size_t& count) noexcept;
+
+    template <typename Other>
+    bool operator==(const TaskAllocator<Other>&) const noexcept { return true; }
+
+  private:
+    static constexpr bool pooled(const std::size_t& count) { return count == 1 && sizeof(Type) <= TaskMemoryPool::k_BlockSize && alignof(Type) <= TaskMemoryPool::k_BlockAlign; }
+};
+
+template <typename Type>
+inline Type* TaskAllocator<Type>::allocate(const std::size_t& count) {
+    if (pooled(count))
+        return static_cast<Type*>(TaskMemoryPool::allocate());
+    return static_cast<Type*>(::operator new(count * sizeof(Type), std::align_val_t(alignof(Type))));
+}
+
+template <typename Type>
+inline void TaskAllocator<Type>::deallocate(Type* object, const std::size_t& count) noexcept {
+    if (pooled(count))
+        TaskMemoryPool::deallocate(object);
+    else
+        ::operator delete(object, std::align_val_t(alignof(Type)));
+}
+
+}  // namespace Melon
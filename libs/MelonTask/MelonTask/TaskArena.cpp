@@ -0,0 +1,37 @@
+#include <MelonTask/TaskArena.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace Melon {
+
+void* TaskArena::allocate(const std::size_t& size, const std::size_t& alignment) {
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    while (m_BlockIndex < m_Blocks.size()) {
+        Block& block = m_Blocks[m_BlockIndex];
+        const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.memory.get());
+        const std::size_t offset = ((base + m_Offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (offset + size <= block.size) {
+            m_Offset = offset + size;
+            return block.memory.get() + offset;
+        }
+        // Try the next cached block, the rest of this one is wasted until rewinding
+        m_BlockIndex++;
+        m_Offset = 0;
+    }
+    // Oversized allocations get a block of their own
+    const std::size_t blockSize = std::max(k_BlockSize, size + alignment);
+    m_Blocks.push_back(Block{std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize});
+    m_BlockIndex = m_Blocks.size() - 1;
+    m_Offset = 0;
+    return allocate(size, alignment);
+}
+
+void TaskArena::rewind(const Marker& marker) {
+    assert(marker.blockIndex < m_BlockIndex || (marker.blockIndex == m_BlockIndex && marker.offset <= m_Offset));
+    m_BlockIndex = marker.blockIndex;
+    m_Offset = marker.offset;
+}
+
+}  // namespace Melon
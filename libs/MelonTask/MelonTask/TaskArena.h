@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace Melon {
+
+// Linear scratch memory owned by a thread, allocations are released together by rewinding
+// Blocks are kept after rewinding, so a warmed up arena never touches the heap
+class TaskArena {
+  public:
+    static constexpr std::size_t k_BlockSize = 64 * 1024;
+
+    // Position of the arena, memory allocated after it is released by rewinding to it
+    struct Marker {
+        std::size_t blockIndex;
+        std::size_t offset;
+    };
+
+    TaskArena() {}
+    TaskArena(const TaskArena&) = delete;
+
+    void* allocate(const std::size_t& size, const std::size_t& alignment = alignof(std::max_align_t));
+    // Memory is uninitialized, and no destructor will be called
+    template <typename Type>
+    Type* allocate(const std::size_t& count);
+
+    Marker marker() const { return Marker{m_BlockIndex, m_Offset}; }
+    void rewind(const Marker& marker);
+    void reset() { rewind(Marker{}); }
+
+  private:
+    struct Block {
+        std::unique_ptr<std::byte[]> memory;
+        std::size_t size;
+    };
+
+    std::vector<Block> m_Blocks;
+    std::size_t m_BlockIndex{};
+    std::size_t m_Offset{};
+};
+
+// Scratch arena of the calling thread
+// Memory allocated by a task is released when the task finishes, and the arena of a ChunkTask is also rewound after each chunk
+// On threads other than workers, it is an arena owned by the thread
+TaskArena& currentWorkerArena();
+
+template <typename Type>
+inline Type* TaskArena::allocate(const std::size_t& count) {
+    static_assert(std::is_trivially_destructible_v<Type>);
+    return static_cast<Type*>(allocate(count * sizeof(Type), alignof(Type)));
+}
+
+}  // namespace Melon
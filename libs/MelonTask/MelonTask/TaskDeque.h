@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Melon {
+
+// Chase-Lev work-stealing deque
+// Only the owner thread could push and pop at the bottom, other threads steal from the top
+template <typename Type>
+class TaskDeque {
+  public:
+    static constexpr std::int64_t k_InitialCapacity = 256;
+
+    TaskDeque();
+    TaskDeque(const TaskDeque&) = delete;
+
+    void push(Type* item);
+    Type* pop();
+    Type* steal();
+
+    std::int64_t size() const;
+    bool empty() const { return size() <= 0; }
+
+  private:
+    struct Buffer {
+        Buffer(const std::int64_t& capacity) : capacity(capacity), mask(capacity - 1), items(capacity) {}
+
+        Type* get(const std::int64_t& index) const { return items[index & mask].load(std::memory_order_relaxed); }
+        void put(const std::int64_t& index, Type* item) { items[index & mask].store(item, std::memory_order_relaxed); }
+
+        const std::int64_t capacity;
+        const std::int64_t mask;
+        std::vector<std::atomic<Type*>> items;
+    };
+
+    Buffer* grow(Buffer* buffer, const std::int64_t& top, const std::int64_t& bottom);
+
+    alignas(64) std::atomic<std::int64_t> m_Top{};
+    alignas(64) std::atomic<std::int64_t> m_Bottom{};
+    alignas(64) std::atomic<Buffer*> m_Buffer;
+    // Retired buffers may still be read by thieves, so they are released with the deque
+    std::vector<std::unique_ptr<Buffer>> m_Buffers;
+};
+
+template <typename Type>
+TaskDeque<Type>::TaskDeque() {
+    m_Buffer.store(m_Buffers.emplace_back(std::make_unique<Buffer>(k_InitialCapacity)).get(), std::memory_order_relaxed);
+}
+
+template <typename Type>
+void TaskDeque<Type>::push(Type* item) {
+    const std::int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+    const std::int64_t top = m_Top.load(std::memory_order_acquire);
+    Buffer* buffer = m_Buffer.load(std::memory_order_relaxed);
+    if (bottom - top > buffer->capacity - 1)
+        buffer = grow(buffer, top, bottom);
+    buffer->put(bottom, item);
+    m_Bottom.store(bottom + 1, std::memory_order_release);
+}
+
+template <typename Type>
+Type* TaskDeque<Type>::pop() {
+    const std::int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = m_Buffer.load(std::memory_order_relaxed);
+    m_Bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t top = m_Top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        m_Bottom.store(bottom + 1, std::memory_order_release);
+        return nullptr;
+    }
+    Type* item = buffer->get(bottom);
+    if (top == bottom) {
+        // Last item, race against thieves
+        if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            item = nullptr;
+        m_Bottom.store(bottom + 1, std::memory_order_release);
+    }
+    return item;
+}
+
+template <typename Type>
+Type* TaskDeque<Type>::steal() {
+    std::int64_t top = m_Top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+    Type* item = m_Buffer.load(std::memory_order_acquire)->get(top);
+    if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return item;
+}
+
+template <typename Type>
+std::int64_t TaskDeque<Type>::size() const {
+    const std::int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+    const std::int64_t top = m_Top.load(std::memory_order_relaxed);
+    return bottom - top;
+}
+
+template <typename Type>
+typename TaskDeque<Type>::Buffer* TaskDeque<Type>::grow(Buffer* buffer, const std::int64_t& top, const std::int64_t& bottom) {
+    Buffer* newBuffer = m_Buffers.emplace_back(std::make_unique<Buffer>(buffer->capacity * 2)).get();
+    for (std::int64_t i = top; i < bottom; i++)
+        newBuffer->put(i, buffer->get(i));
+    m_Buffer.store(newBuffer, std::memory_order_release);
+    return newBuffer;
+}
+
+}  // namespace Melon
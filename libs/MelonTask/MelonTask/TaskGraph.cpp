@@ -0,0 +1,81 @@
+#include <MelonTask/TaskGraph.h>
+
+namespace Melon {
+
+TaskGraph::TaskGraph(TaskManager* taskManager) : m_TaskManager(taskManager), m_Sink(taskManager->createTask(nullptr, TaskPriority::Critical)) {}
+
+TaskGraph::~TaskGraph() {
+    // Running tasks are referring to the successor nodes
+    if (m_Running)
+        m_Sink->complete();
+}
+
+std::shared_ptr<TaskHandle> const& TaskGraph::run(std::vector<std::shared_ptr<TaskHandle>> const& predecessors) {
+    if (m_Running)
+        m_Sink->complete();
+    if (!m_Wired)
+        wire();
+    m_Running = true;
+
+    // Hold all tasks by an extra predecessor count until the dependencies are ready
+    for (Node const& node : m_Nodes)
+        node.taskHandle->rearm(static_cast<unsigned int>(node.predecessors.size()) + 1);
+    m_Sink->rearm(m_SinkPredecessorCount + 1);
+    m_ExternalSuccessorNodes.resize(m_RootTaskHandles.size() * predecessors.size());
+    for (unsigned int i = 0; i < m_RootTaskHandles.size(); i++) {
+        TaskHandle* rootTaskHandle = m_RootTaskHandles[i];
+        rootTaskHandle->m_PredecessorCount += static_cast<unsigned int>(predecessors.size());
+        for (unsigned int j = 0; j < predecessors.size(); j++) {
+            TaskHandle::SuccessorNode& successorNode = m_ExternalSuccessorNodes[i * predecessors.size() + j];
+            successorNode.successor = rootTaskHandle;
+            // The handle of the previous run is finished, though it has been rearmed
+            if (!predecessors[j] || predecessors[j] == m_Sink || !predecessors[j]->appendSuccessor(&successorNode))
+                rootTaskHandle->m_PredecessorCount--;
+        }
+    }
+    for (Node const& node : m_Nodes)
+        if (--node.taskHandle->m_PredecessorCount == 0)
+            m_ReadyTaskHandles.emplace_back(std::move(node.taskHandle->m_Self));
+    if (--m_Sink->m_PredecessorCount == 0)
+        m_ReadyTaskHandles.emplace_back(std::move(m_Sink->m_Self));
+    m_TaskManager->queueTasks(m_ReadyTaskHandles);
+    m_ReadyTaskHandles.clear();
+    return m_Sink;
+}
+
+void TaskGraph::wire() {
+    unsigned int successorNodeCount = 0;
+    for (Node const& node : m_Nodes) {
+        node.taskHandle->m_RecordedSuccessorHead = nullptr;
+        successorNodeCount += static_cast<unsigned int>(node.predecessors.size());
+    }
+    // Nodes without successors are linked to the sink
+    m_SuccessorNodes.assign(successorNodeCount + m_Nodes.size(), TaskHandle::SuccessorNode{});
+    std::vector<bool> hasSuccessors(m_Nodes.size());
+    m_RootTaskHandles.clear();
+    unsigned int successorNodeIndex = 0;
+    for (unsigned int i = 0; i < m_Nodes.size(); i++) {
+        if (m_Nodes[i].predecessors.empty())
+            m_RootTaskHandles.push_back(m_Nodes[i].taskHandle.get());
+        for (const unsigned int& predecessor : m_Nodes[i].predecessors) {
+            TaskHandle* predecessorTaskHandle = m_Nodes[predecessor].taskHandle.get();
+            m_SuccessorNodes[successorNodeIndex] = TaskHandle::SuccessorNode{m_Nodes[i].taskHandle.get(), predecessorTaskHandle->m_RecordedSuccessorHead};
+            predecessorTaskHandle->m_RecordedSuccessorHead = &m_SuccessorNodes[successorNodeIndex++];
+            hasSuccessors[predecessor] = true;
+        }
+    }
+    m_SinkPredecessorCount = 0;
+    for (unsigned int i = 0; i < m_Nodes.size(); i++) {
+        if (hasSuccessors[i]) continue;
+        TaskHandle* taskHandle = m_Nodes[i].taskHandle.get();
+        m_SuccessorNodes[successorNodeIndex] = TaskHandle::SuccessorNode{m_Sink.get(), taskHandle->m_RecordedSuccessorHead};
+        taskHandle->m_RecordedSuccessorHead = &m_SuccessorNodes[successorNodeIndex++];
+        m_SinkPredecessorCount++;
+    }
+    // An empty graph simply waits for the predecessors
+    if (m_Nodes.empty())
+        m_RootTaskHandles.push_back(m_Sink.get());
+    m_Wired = true;
+}
+
+}  // namespace Melon
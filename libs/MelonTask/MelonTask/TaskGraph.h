@@ -0,0 +1,67 @@
+#pragma once
+
+#include <MelonTask/TaskHandle.h>
+#include <MelonTask/TaskManager.h>
+#include <MelonTask/TaskPriority.h>
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Melon {
+
+// A DAG of tasks recorded once and replayed many times
+// Replaying reuses the TaskHandles and the dependencies, so nothing is allocated in the steady state
+// Per-run payloads should be rebound through the states referenced by the procedures
+class TaskGraph {
+  public:
+    TaskGraph(TaskManager* taskManager);
+    TaskGraph(const TaskGraph&) = delete;
+    ~TaskGraph();
+
+    // Predecessors are indices of recorded nodes, the index of the new node is returned
+    template <typename Procedure>
+    unsigned int record(Procedure&& procedure, std::vector<unsigned int> const& predecessors = {}, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+
+    // Nodes without recorded predecessors wait for the given predecessors, and they are queued at once instead of waiting for activation
+    // The returned handle is finished after all nodes, it is reused by the next run, which treats it as a finished predecessor
+    std::shared_ptr<TaskHandle> const& run(std::vector<std::shared_ptr<TaskHandle>> const& predecessors);
+
+  private:
+    struct Node {
+        std::shared_ptr<TaskHandle> taskHandle;
+        std::vector<unsigned int> predecessors;
+    };
+
+    // Build the recorded successor lists after nodes are recorded
+    void wire();
+
+    TaskManager* const m_TaskManager;
+    std::vector<Node> m_Nodes;
+    // Successor of all nodes without successors
+    std::shared_ptr<TaskHandle> m_Sink;
+    unsigned int m_SinkPredecessorCount{};
+    std::vector<TaskHandle*> m_RootTaskHandles;
+    std::vector<TaskHandle::SuccessorNode> m_SuccessorNodes;
+    // Nodes for the predecessors given to run, reused across runs
+    std::vector<TaskHandle::SuccessorNode> m_ExternalSuccessorNodes;
+    // Tasks ready at once when running, queued together
+    std::vector<std::shared_ptr<TaskHandle>> m_ReadyTaskHandles;
+    bool m_Wired{};
+    bool m_Running{};
+};
+
+template <typename Procedure>
+unsigned int TaskGraph::record(Procedure&& procedure, std::vector<unsigned int> const& predecessors, const TaskPriority& priority, const char* name) {
+    // TaskHandles are being used by the previous run
+    if (m_Running)
+        m_Sink->complete();
+    assert(std::all_of(predecessors.begin(), predecessors.end(), [this](const unsigned int& predecessor) { return predecessor < m_Nodes.size(); }));
+    m_Nodes.push_back(Node{m_TaskManager->createTask(std::forward<Procedure>(procedure), priority, name), predecessors});
+    m_Wired = false;
+    return static_cast<unsigned int>(m_Nodes.size() - 1);
+}
+
+}  // namespace Melon
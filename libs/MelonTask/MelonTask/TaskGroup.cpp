@@ -0,0 +1,32 @@
+#include <MelonTask/TaskAllocator.h>
+#include <MelonTask/TaskGroup.h>
+
+namespace Melon {
+
+TaskGroup::TaskGroup(TaskManager* taskManager) : m_TaskManager(taskManager), m_State(std::allocate_shared<State>(TaskAllocator<State>())) {
+    m_State->join = taskManager->createTask(nullptr, TaskPriority::Critical);
+}
+
+TaskGroup::~TaskGroup() {
+    if (!m_Closed)
+        join();
+}
+
+std::shared_ptr<TaskHandle> const& TaskGroup::join() {
+    if (!m_Closed) {
+        m_Closed = true;
+        release(m_State.get());
+    }
+    return m_State->join;
+}
+
+void TaskGroup::wait() {
+    join()->complete();
+}
+
+void TaskGroup::release(State* state) {
+    if (state->remainingTaskCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        state->join->notifyFinished();
+}
+
+}  // namespace Melon
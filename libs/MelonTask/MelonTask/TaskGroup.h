@@ -0,0 +1,67 @@
+#pragma once
+
+#include <MelonTask/TaskHandle.h>
+#include <MelonTask/TaskManager.h>
+#include <MelonTask/TaskPriority.h>
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Melon {
+
+// Fork-join scope, its join is finished after all tasks spawned in the group are finished
+// Each task releases the group by decrementing a counter, so joining needs no extra task or queueing
+class TaskGroup {
+  public:
+    TaskGroup(TaskManager* taskManager);
+    TaskGroup(const TaskGroup&) = delete;
+    // Close the group if it is not joined, the tasks keep running
+    ~TaskGroup();
+
+    // Tasks are queued at once like TaskManager::spawn
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> spawn(Procedure&& procedure, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> spawn(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+
+    // Close the group and return the join, no task could be spawned in the group afterwards
+    std::shared_ptr<TaskHandle> const& join();
+    // Close the group and execute other tasks until the join is finished
+    void wait();
+
+  private:
+    struct State {
+        // The group itself holds one count until it is closed
+        std::atomic<unsigned int> remainingTaskCount{1};
+        std::shared_ptr<TaskHandle> join;
+    };
+
+    static void release(State* state);
+
+    TaskManager* const m_TaskManager;
+    std::shared_ptr<State> m_State;
+    bool m_Closed{};
+};
+
+template <typename Procedure>
+inline std::shared_ptr<TaskHandle> TaskGroup::spawn(Procedure&& procedure, const TaskPriority& priority, const char* name) {
+    return spawn(std::forward<Procedure>(procedure), std::vector<std::shared_ptr<TaskHandle>>(), priority, name);
+}
+
+template <typename Procedure>
+inline std::shared_ptr<TaskHandle> TaskGroup::spawn(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority, const char* name) {
+    assert(!m_Closed);
+    m_State->remainingTaskCount.fetch_add(1, std::memory_order_relaxed);
+    auto member = [procedure = std::forward<Procedure>(procedure), state = m_State]() mutable {
+        procedure();
+        release(state.get());
+    };
+    if (predecessors.empty())
+        return m_TaskManager->spawn(std::move(member), priority, name);
+    return m_TaskManager->spawn(std::move(member), predecessors, priority, name);
+}
+
+}  // namespace Melon
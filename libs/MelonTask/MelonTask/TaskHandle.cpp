@@ -4,7 +4,7 @@
 namespace Melon {
 
 void TaskHandle::complete() {
-    m_FinishSharedFuture.get();
+    m_TaskManager->helpUntilFinished(this);
 }
 
 bool TaskHandle::finished() {
@@ -12,21 +12,31 @@ bool TaskHandle::finished() {
 }
 
 void TaskHandle::initPredecessors(std::vector<std::shared_ptr<TaskHandle>> const& predecessors) {
+    SuccessorNode* successorNodes = m_InlineSuccessorNodes.data();
+    if (predecessors.size() > k_InlinePredecessorCount) {
+        m_SuccessorNodes = std::make_unique<SuccessorNode[]>(predecessors.size());
+        successorNodes = m_SuccessorNodes.get();
+    }
+    // Predecessors may finish at once on other threads, so hold itself before appending
+    m_Self = shared_from_this();
     // To avoid unexpected enqueueing
     m_PredecessorCount = predecessors.size() + 1;
-    for (std::shared_ptr<TaskHandle> predecessor : predecessors)
-        if (!predecessor || !predecessor->appendSuccessor(shared_from_this()))
+    for (unsigned int i = 0; i < predecessors.size(); i++) {
+        successorNodes[i].successor = this;
+        if (!predecessors[i] || !predecessors[i]->appendSuccessor(&successorNodes[i]))
             m_PredecessorCount--;
-    notifyPredecessorFinished();
+    }
+    notifyPredecessorFinished(true);
 }
 
-bool TaskHandle::appendSuccessor(std::shared_ptr<TaskHandle> successor) {
-    std::lock_guard lock(m_FinishedMutex);
-    if (!m_Finished) {
-        m_Successors.emplace_back(successor);
-        return true;
-    }
-    return false;
+bool TaskHandle::appendSuccessor(SuccessorNode* successorNode) {
+    SuccessorNode* head = m_SuccessorHead.load(std::memory_order_acquire);
+    do {
+        if (head == finishedSuccessorNode())
+            return false;
+        successorNode->next = head;
+    } while (!m_SuccessorHead.compare_exchange_weak(head, successorNode, std::memory_order_acq_rel, std::memory_order_acquire));
+    return true;
 }
 
 void TaskHandle::execute() {
@@ -35,16 +45,40 @@ void TaskHandle::execute() {
 }
 
 void TaskHandle::notifyFinished() {
-    std::lock_guard lock(m_FinishedMutex);
+    SuccessorNode* successorNode = m_SuccessorHead.exchange(finishedSuccessorNode(), std::memory_order_acq_rel);
+    while (successorNode) {
+        // The node is owned by the successor, which may be released once notified
+        SuccessorNode* next = successorNode->next;
+        successorNode->successor->notifyPredecessorFinished();
+        successorNode = next;
+    }
+    // Published after the successor list is done with, since a waiter may rearm the task as soon as it sees the flag
     m_Finished = true;
-    m_FinishPromise.set_value();
-    for (auto& successors : m_Successors)
-        successors->notifyPredecessorFinished();
+    if (m_WaiterCount > 0)
+        m_TaskManager->wakeWaitingThreads();
+}
+
+void TaskHandle::notifyPredecessorFinished(const bool& spawning) {
+    if (--m_PredecessorCount == 0) {
+        std::shared_ptr<TaskHandle> self = std::move(m_Self);
+        // A join without procedure is finished at once by its last predecessor, instead of a round trip through the queue
+        if (!m_Procedure && !m_MainThreadOnly)
+            notifyFinished();
+        else
+            m_TaskManager->queueTask(self, spawning);
+    }
+}
+
+void TaskHandle::rearm(const unsigned int& predecessorCount) {
+    m_Finished = false;
+    m_SuccessorHead = m_RecordedSuccessorHead;
+    m_PredecessorCount = predecessorCount;
+    m_Self = shared_from_this();
 }
 
-void TaskHandle::notifyPredecessorFinished() {
-    if (--m_PredecessorCount == 0)
-        m_TaskManager->queueTask(shared_from_this());
+TaskHandle::SuccessorNode* TaskHandle::finishedSuccessorNode() {
+    static SuccessorNode node{};
+    return &node;
 }
 
 }  // namespace Melon
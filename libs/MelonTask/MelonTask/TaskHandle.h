@@ -1,10 +1,14 @@
 #pragma once
 
+#include <MelonTask/TaskAllocator.h>
+#include <MelonTask/TaskPriority.h>
+#include <MelonTask/TaskProcedure.h>
+
+#include <array>
 #include <atomic>
-#include <functional>
-#include <future>
+#include <cstdint>
 #include <memory>
-#include <mutex>
+#include <utility>
 #include <vector>
 
 namespace Melon {
@@ -13,30 +17,66 @@ class TaskManager;
 
 class TaskHandle : public std::enable_shared_from_this<TaskHandle> {
   public:
-    TaskHandle(TaskManager* taskManager, std::function<void()> const& procedure) : m_TaskManager(taskManager), m_Procedure(procedure), m_FinishSharedFuture(m_FinishPromise.get_future()) {}
+    // Successor nodes for this count of predecessors are stored inline
+    static constexpr unsigned int k_InlinePredecessorCount = 4;
+
+    template <typename Procedure>
+    TaskHandle(TaskManager* taskManager, Procedure&& procedure, const TaskPriority& priority) : m_TaskManager(taskManager), m_Priority(priority), m_Procedure(std::forward<Procedure>(procedure)) {}
+    TaskHandle(const TaskHandle&) = delete;
+    // Execute other ready tasks on the calling thread until this task is finished
     void complete();
     bool finished();
 
+    const TaskPriority& priority() const { return m_Priority; }
+
   private:
+    // Node of the lock-free successor list of a predecessor, owned by the successor
+    struct SuccessorNode {
+        TaskHandle* successor;
+        SuccessorNode* next;
+    };
+
     void initPredecessors(std::vector<std::shared_ptr<TaskHandle>> const& predecessors);
-    bool appendSuccessor(std::shared_ptr<TaskHandle> successor);
+    bool appendSuccessor(SuccessorNode* successorNode);
     void execute();
     void notifyFinished();
-    void notifyPredecessorFinished();
+    // Spawning if the notifying thread keeps running its own task afterwards
+    void notifyPredecessorFinished(const bool& spawning = false);
+    // Make a finished task runnable again with the recorded successors, used by TaskGraph
+    void rearm(const unsigned int& predecessorCount);
+
+    // Marks the successor list closed after the task is finished
+    static SuccessorNode* finishedSuccessorNode();
 
     TaskManager* const m_TaskManager;
-    std::function<void()> m_Procedure;
+    const TaskPriority m_Priority;
+    // Only executed by the main thread of the TaskManager
+    bool m_MainThreadOnly{};
+    TaskProcedure m_Procedure;
     std::atomic<unsigned int> m_PredecessorCount;
-    std::vector<std::shared_ptr<TaskHandle>> m_Successors;
-    std::mutex m_Mtx;
-    std::condition_variable m_Cv;
-    bool m_Finished{};
-    std::mutex m_FinishedMutex;
-    std::promise<void> m_FinishPromise;
-    std::shared_future<void> m_FinishSharedFuture;
+    std::atomic<SuccessorNode*> m_SuccessorHead{};
+    SuccessorNode* m_RecordedSuccessorHead{};
+    std::array<SuccessorNode, k_InlinePredecessorCount> m_InlineSuccessorNodes;
+    std::unique_ptr<SuccessorNode[]> m_SuccessorNodes;
+    std::atomic<bool> m_Finished{};
+    // Count of threads sleeping in complete()
+    std::atomic<unsigned int> m_WaiterCount{};
+    // Hold by itself from activation until it is taken to execute
+    std::shared_ptr<TaskHandle> m_Self;
+#ifdef MELON_TASK_TRACING
+    const char* m_Name{};
+    std::uint64_t m_QueuedTime{};
+#endif
 
+    friend class TaskGraph;
+    friend class TaskGroup;
+    friend class TaskHandleAwaiter;
     friend class TaskManager;
+    friend class TaskPromiseBase;
     friend class TaskWorker;
 };
 
+// Otherwise every task silently falls back to the heap
+static_assert(sizeof(TaskHandle) + TaskMemoryPool::k_ControlBlockSize <= TaskMemoryPool::k_BlockSize, "TaskHandle should fit in a pooled block with its control block");
+
 }  // namespace Melon
@@ -1,48 +1,92 @@
 #include <MelonTask/TaskManager.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
 namespace Melon {
 
-TaskManager::TaskManager() {
-    for (std::unique_ptr<TaskWorker>& worker : m_Workers)
-        worker = std::make_unique<TaskWorker>(this);
+namespace {
+
+// Nesting of tasks executed while waiting in TaskHandle::complete()
+thread_local unsigned int t_HelpDepth{};
+
+// Hint the core that it is spinning
+void cpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+}  // namespace
+
+TaskManager::TaskManager(const TaskManagerConfiguration& configuration) : m_MainThreadId(std::this_thread::get_id()), m_IdleSpinCount(configuration.idlePolicy.spinCount), m_IdleYieldCount(configuration.idlePolicy.yieldCount) {
+    const unsigned int coreCount = std::clamp(std::thread::hardware_concurrency(), 1U, TaskManagerConfiguration::k_MaxCoreCount);
+    std::vector<unsigned int> cores;
+    for (unsigned int i = 0; i < coreCount; i++)
+        if (!configuration.reservedCoreMask.test(i))
+            cores.push_back(i);
+    const unsigned int workerCount = configuration.workerCount != 0 ? configuration.workerCount : std::max(static_cast<unsigned int>(cores.size()), 1U);
+    for (unsigned int i = 0; i < workerCount; i++)
+        m_Workers.emplace_back(std::make_unique<TaskWorker>(this, i));
+    m_MaxBackgroundWorkerCount = configuration.maxBackgroundWorkerCount != 0 ? configuration.maxBackgroundWorkerCount : std::max(workerCount / 4, 1U);
+    // Workers steal from each other, so start them after all of them are created
+    for (std::unique_ptr<TaskWorker> const& worker : m_Workers)
+        worker->start();
+    // Cores may be refused when the process is restricted to a subset of them, a partially pinned pool balances worse than an unpinned one
+    if (configuration.pinWorkers && !cores.empty()) {
+        for (std::unique_ptr<TaskWorker> const& worker : m_Workers) {
+            const unsigned int core = cores[worker->index() % cores.size()];
+            if (worker->pin(core))
+                continue;
+            for (std::unique_ptr<TaskWorker> const& pinnedWorker : m_Workers)
+                pinnedWorker->unpin();
+            std::fprintf(stderr, "Failed to pin worker %u to core %u, all workers are reset to the affinity of the process\n", worker->index(), core);
+            break;
+        }
+    }
 }
 
 TaskManager::~TaskManager() {
     m_Stopped = true;
     for (std::unique_ptr<TaskWorker> const& worker : m_Workers)
         worker->notify_stopped();
-    m_TaskQueueConditionVariable.notify_all();
+    wakeWorkers(workerCount());
     for (std::unique_ptr<TaskWorker> const& worker : m_Workers)
         worker->join();
-}
-
-std::shared_ptr<TaskHandle> TaskManager::schedule(std::function<void()> const& procedure) {
-    std::shared_ptr<TaskHandle> taskHandle = std::make_shared<TaskHandle>(this, procedure);
-    m_WaitingTaskQueue.emplace(taskHandle);
-    return taskHandle;
-}
-
-std::shared_ptr<TaskHandle> TaskManager::schedule(std::function<void()> const& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors) {
-    std::shared_ptr<TaskHandle> taskHandle = std::make_shared<TaskHandle>(this, procedure);
-    m_WaitingTaskAndPredecessorsQueue.emplace(taskHandle, predecessors);
-    return taskHandle;
-}
-
-std::shared_ptr<TaskHandle> TaskManager::schedule(std::function<void()> const& procedure, std::vector<std::shared_ptr<TaskHandle>>&& predecessors) {
-    std::shared_ptr<TaskHandle> taskHandle = std::make_shared<TaskHandle>(this, procedure);
-    m_WaitingTaskAndPredecessorsQueue.emplace(taskHandle, std::move(predecessors));
-    return taskHandle;
+    // Release tasks left in deques, they are holding themselves
+    for (std::unique_ptr<TaskWorker> const& worker : m_Workers)
+        for (unsigned int i = 0; i < k_TaskPriorityCount; i++)
+            while (worker->pop(static_cast<TaskPriority>(i)))
+                ;
 }
 
 std::shared_ptr<TaskHandle> TaskManager::combine(std::vector<std::shared_ptr<TaskHandle>> const& taskHandles) {
-    return schedule(nullptr, taskHandles);
+    return schedule(nullptr, taskHandles, TaskPriority::Critical);
 }
 
 void TaskManager::activateWaitingTasks() {
+    std::lock_guard waitingTaskLock(m_WaitingTaskMutex);
+    const unsigned int readyTaskCount = static_cast<unsigned int>(m_WaitingTaskQueue.size());
     {
         std::lock_guard lock(m_TaskQueueMutex);
         while (!m_WaitingTaskQueue.empty()) {
-            m_TaskQueue.emplace(m_WaitingTaskQueue.front());
+            const unsigned int lane = static_cast<unsigned int>(m_WaitingTaskQueue.front()->m_Priority);
+            markQueued(m_WaitingTaskQueue.front().get());
+            if (m_WaitingTaskQueue.front()->m_MainThreadOnly) {
+                m_MainThreadTaskQueue.emplace(std::move(m_WaitingTaskQueue.front()));
+                m_MainThreadTaskCount++;
+            } else {
+                m_TaskQueues[lane].emplace(std::move(m_WaitingTaskQueue.front()));
+                m_QueuedTaskCounts[lane]++;
+            }
             m_WaitingTaskQueue.pop();
         }
     }
@@ -52,23 +96,272 @@ void TaskManager::activateWaitingTasks() {
         taskHandle->initPredecessors(predecessors);
         m_WaitingTaskAndPredecessorsQueue.pop();
     }
-    m_TaskQueueConditionVariable.notify_all();
+    // Tasks with finished predecessors have been queued and woken by themselves
+    wakeWorkers(readyTaskCount);
 }
 
-void TaskManager::queueTask(std::shared_ptr<TaskHandle> const& task) {
-    std::lock_guard lock(m_TaskQueueMutex);
-    m_TaskQueue.push(task);
-    m_TaskQueueConditionVariable.notify_one();
+void TaskManager::executeMainThreadTasks() {
+    assert(std::this_thread::get_id() == m_MainThreadId);
+    while (std::shared_ptr<TaskHandle> task = fetchMainThreadTask())
+        executeTask(task);
+}
+
+void TaskManager::setIdlePolicy(const TaskIdlePolicy& idlePolicy) {
+    m_IdleSpinCount.store(idlePolicy.spinCount, std::memory_order_relaxed);
+    m_IdleYieldCount.store(idlePolicy.yieldCount, std::memory_order_relaxed);
+}
+
+TaskIdlePolicy TaskManager::idlePolicy() const {
+    return TaskIdlePolicy{m_IdleSpinCount.load(std::memory_order_relaxed), m_IdleYieldCount.load(std::memory_order_relaxed)};
+}
+
+void TaskManager::writeTrace(std::ostream& stream) const {
+#ifdef MELON_TASK_TRACING
+    m_TaskTracer.write(stream, workerCount());
+#else
+    stream << "{\"traceEvents\":[]}\n";
+#endif
+}
+
+unsigned int TaskManager::currentThreadIndex() const {
+    TaskWorker* worker = TaskWorker::current();
+    return worker && worker->m_TaskManager == this ? worker->index() : workerCount();
+}
+
+void TaskManager::queueTask(std::shared_ptr<TaskHandle> const& task, const bool& spawning) {
+    if (task->m_MainThreadOnly) {
+        queueMainThreadTask(task);
+        return;
+    }
+    const unsigned int lane = static_cast<unsigned int>(task->m_Priority);
+    markQueued(task.get());
+    TaskWorker* worker = TaskWorker::current();
+    if (worker && worker->m_TaskManager == this) {
+        worker->push(task);
+        m_QueuedTaskCounts[lane]++;
+        // A finished task leaves the last pushed one to its worker, only wake others for the rest
+        if (spawning || worker->m_TaskDeques[lane].size() > 1)
+            wakeWorkers(1);
+        return;
+    }
+    {
+        std::lock_guard lock(m_TaskQueueMutex);
+        m_TaskQueues[lane].push(task);
+        m_QueuedTaskCounts[lane]++;
+    }
+    wakeWorkers(1);
+}
+
+void TaskManager::queueMainThreadTask(std::shared_ptr<TaskHandle> const& task) {
+    markQueued(task.get());
+    {
+        std::lock_guard lock(m_TaskQueueMutex);
+        m_MainThreadTaskQueue.push(task);
+        m_MainThreadTaskCount++;
+    }
+    wakeWaitingThreads();
+}
+
+void TaskManager::queueTasks(std::vector<std::shared_ptr<TaskHandle>> const& tasks) {
+    if (tasks.empty()) return;
+    TaskWorker* worker = TaskWorker::current();
+    const bool ownWorker = worker && worker->m_TaskManager == this;
+    if (ownWorker) {
+        for (std::shared_ptr<TaskHandle> const& task : tasks) {
+            if (task->m_MainThreadOnly) {
+                queueMainThreadTask(task);
+                continue;
+            }
+            markQueued(task.get());
+            worker->push(task);
+            m_QueuedTaskCounts[static_cast<unsigned int>(task->m_Priority)]++;
+        }
+    } else {
+        std::lock_guard lock(m_TaskQueueMutex);
+        for (std::shared_ptr<TaskHandle> const& task : tasks) {
+            const unsigned int lane = static_cast<unsigned int>(task->m_Priority);
+            markQueued(task.get());
+            if (task->m_MainThreadOnly) {
+                m_MainThreadTaskQueue.push(task);
+                m_MainThreadTaskCount++;
+            } else {
+                m_TaskQueues[lane].push(task);
+                m_QueuedTaskCounts[lane]++;
+            }
+        }
+    }
+    // The worker itself will take one of them
+    wakeWorkers(static_cast<unsigned int>(tasks.size()) - (ownWorker ? 1 : 0));
+}
+
+std::shared_ptr<TaskHandle> TaskManager::getNextTask(TaskWorker* worker) {
+    while (!m_Stopped) {
+        std::shared_ptr<TaskHandle> task = fetchTask(worker, true);
+        if (task) return task;
+        waitForTask();
+    }
+    return nullptr;
+}
+
+void TaskManager::waitForTask() {
+    const unsigned int spinCount = m_IdleSpinCount.load(std::memory_order_relaxed);
+    const unsigned int idleCount = spinCount + m_IdleYieldCount.load(std::memory_order_relaxed);
+    for (unsigned int i = 0; i < idleCount; i++) {
+        // Background tasks are not takeable while all slots are taken
+        if (hasTakeableTask(true) || m_Stopped) return;
+        if (i < spinCount)
+            cpuRelax();
+        else
+            std::this_thread::yield();
+    }
+    // Load the epoch after counting itself and check again, so that a task queued meanwhile either is seen or changes the epoch
+    m_SleepingWorkerCount++;
+    const unsigned int wakeEpoch = m_WakeEpoch.load();
+    if (!hasTakeableTask(true) && !m_Stopped)
+        m_WakeEpoch.wait(wakeEpoch);
+    m_SleepingWorkerCount--;
 }
 
-std::shared_ptr<TaskHandle> TaskManager::getNextTask() {
-    std::unique_lock lock(m_TaskQueueMutex);
-    // To avoid spurious wakeup
-    while (m_TaskQueue.empty() && !m_Stopped) m_TaskQueueConditionVariable.wait(lock);
-    if (m_Stopped) return nullptr;
-    std::shared_ptr<TaskHandle> task = m_TaskQueue.front();
-    m_TaskQueue.pop();
+std::shared_ptr<TaskHandle> TaskManager::fetchTask(TaskWorker* worker, const bool& allowBackground, const bool& ownDequeOnly) {
+    if (ownDequeOnly && !worker) return nullptr;
+    for (unsigned int i = 0; i < k_TaskPriorityCount; i++) {
+        const TaskPriority priority = static_cast<TaskPriority>(i);
+        // Skip empty lanes without touching the shared queue and other workers
+        if (m_QueuedTaskCounts[i] == 0) continue;
+        if (priority == TaskPriority::Background && (!allowBackground || !acquireBackgroundSlot())) continue;
+        std::shared_ptr<TaskHandle> task = fetchTask(worker, priority, ownDequeOnly);
+        if (task) return task;
+        if (priority == TaskPriority::Background)
+            m_RunningBackgroundTaskCount--;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<TaskHandle> TaskManager::fetchTask(TaskWorker* worker, const TaskPriority& priority, const bool& ownDequeOnly) {
+    const unsigned int lane = static_cast<unsigned int>(priority);
+    if (worker) {
+        std::shared_ptr<TaskHandle> task = worker->pop(priority);
+        if (task || ownDequeOnly) return task;
+    }
+    // Fetch a batch from the shared queue, so that other workers could steal from this worker instead of the contended queue
+    {
+        std::lock_guard lock(m_TaskQueueMutex);
+        std::queue<std::shared_ptr<TaskHandle>>& taskQueue = m_TaskQueues[lane];
+        if (!taskQueue.empty()) {
+            std::shared_ptr<TaskHandle> task = std::move(taskQueue.front());
+            taskQueue.pop();
+            m_QueuedTaskCounts[lane]--;
+            const std::size_t fetchCount = worker ? std::min<std::size_t>(taskQueue.size() / m_Workers.size(), k_MaxFetchCount) : 0;
+            for (std::size_t i = 0; i < fetchCount; i++) {
+                worker->push(taskQueue.front());
+                taskQueue.pop();
+            }
+            return task;
+        }
+    }
+    const unsigned int firstVictimIndex = worker ? worker->index() + 1 : 0;
+    for (unsigned int i = 0; i < m_Workers.size(); i++) {
+        TaskWorker* victim = m_Workers[(firstVictimIndex + i) % m_Workers.size()].get();
+        if (victim == worker) continue;
+        std::shared_ptr<TaskHandle> task = victim->steal(priority);
+        if (task) return task;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<TaskHandle> TaskManager::fetchMainThreadTask() {
+    if (m_MainThreadTaskCount == 0) return nullptr;
+    std::lock_guard lock(m_TaskQueueMutex);
+    if (m_MainThreadTaskQueue.empty()) return nullptr;
+    std::shared_ptr<TaskHandle> task = std::move(m_MainThreadTaskQueue.front());
+    m_MainThreadTaskQueue.pop();
+    m_MainThreadTaskCount--;
     return task;
 }
 
+void TaskManager::executeTask(std::shared_ptr<TaskHandle> const& task) {
+    // Rewind instead of reset, the task may be executed while another one waits in TaskHandle::complete()
+    TaskArena& arena = currentWorkerArena();
+    const TaskArena::Marker marker = arena.marker();
+#ifdef MELON_TASK_TRACING
+    const std::uint64_t beginTime = m_TaskTracer.now();
+    task->execute();
+    m_TaskTracer.record(currentThreadIndex(), TaskTracer::Event{task->m_Name, task->m_QueuedTime, beginTime, m_TaskTracer.now()});
+#else
+    task->execute();
+#endif
+    arena.rewind(marker);
+    task->notifyFinished();
+    if (task->m_Priority == TaskPriority::Background) {
+        m_RunningBackgroundTaskCount--;
+        if (m_QueuedTaskCounts[static_cast<unsigned int>(TaskPriority::Background)] > 0)
+            wakeWorkers(1);
+    }
+}
+
+bool TaskManager::hasTakeableTask(const bool& allowBackground) const {
+    if (m_QueuedTaskCounts[static_cast<unsigned int>(TaskPriority::Critical)] > 0 || m_QueuedTaskCounts[static_cast<unsigned int>(TaskPriority::Normal)] > 0)
+        return true;
+    return allowBackground && m_QueuedTaskCounts[static_cast<unsigned int>(TaskPriority::Background)] > 0 && m_RunningBackgroundTaskCount < m_MaxBackgroundWorkerCount;
+}
+
+bool TaskManager::acquireBackgroundSlot() {
+    unsigned int runningCount = m_RunningBackgroundTaskCount;
+    do {
+        if (runningCount >= m_MaxBackgroundWorkerCount)
+            return false;
+    } while (!m_RunningBackgroundTaskCount.compare_exchange_weak(runningCount, runningCount + 1));
+    return true;
+}
+
+void TaskManager::helpUntilFinished(TaskHandle* taskHandle) {
+    TaskWorker* worker = TaskWorker::current();
+    if (worker && worker->m_TaskManager != this)
+        worker = nullptr;
+    // Threads other than workers never take background tasks, so that waiting for a frame is never delayed by them
+    const bool allowBackground = worker != nullptr;
+    // Nested helping could overflow the stack, so beyond the max depth only tasks in its own deques are executed
+    // They are pushed by this thread, mostly spawned by the tasks it is waiting for
+    const bool ownDequeOnly = t_HelpDepth >= k_MaxHelpDepth;
+    // Nobody else could execute main thread tasks, so they come first
+    const bool mainThread = std::this_thread::get_id() == m_MainThreadId;
+    while (!taskHandle->finished()) {
+        std::shared_ptr<TaskHandle> task = mainThread ? fetchMainThreadTask() : nullptr;
+        if (!task)
+            task = fetchTask(worker, allowBackground, ownDequeOnly);
+        if (task) {
+            t_HelpDepth++;
+            executeTask(task);
+            t_HelpDepth--;
+            continue;
+        }
+        std::unique_lock lock(m_SleepMutex);
+        m_WaitingThreadCount++;
+        taskHandle->m_WaiterCount++;
+        m_WaitingThreadConditionVariable.wait(lock, [this, taskHandle, allowBackground, ownDequeOnly, mainThread]() { return (!ownDequeOnly && hasTakeableTask(allowBackground)) || (mainThread && m_MainThreadTaskCount > 0) || taskHandle->finished() || m_Stopped; });
+        taskHandle->m_WaiterCount--;
+        m_WaitingThreadCount--;
+    }
+}
+
+void TaskManager::wakeWorkers(const unsigned int& count) {
+    // Spinning workers are not counted, they find new tasks without being woken
+    const unsigned int sleepingWorkerCount = m_SleepingWorkerCount;
+    if (count > 0 && sleepingWorkerCount > 0) {
+        m_WakeEpoch.fetch_add(1);
+        if (count >= sleepingWorkerCount)
+            m_WakeEpoch.notify_all();
+        else
+            for (unsigned int i = 0; i < count; i++)
+                m_WakeEpoch.notify_one();
+    }
+    wakeWaitingThreads();
+}
+
+void TaskManager::wakeWaitingThreads() {
+    if (m_WaitingThreadCount == 0) return;
+    std::lock_guard lock(m_SleepMutex);
+    m_WaitingThreadConditionVariable.notify_all();
+}
+
 }  // namespace Melon
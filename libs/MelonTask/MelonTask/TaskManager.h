@@ -1,12 +1,24 @@
 #pragma once
 
+#include <MelonTask/TaskAllocator.h>
+#include <MelonTask/TaskArena.h>
 #include <MelonTask/TaskHandle.h>
+#include <MelonTask/TaskPriority.h>
+#include <MelonTask/TaskTracer.h>
 #include <MelonTask/TaskWorker.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <queue>
+#include <span>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace Melon {
@@ -14,35 +26,306 @@ namespace Melon {
 class TaskHandle;
 class TaskWorker;
 
+// How an idle worker waits for tasks, it spins with pause instructions, then yields its time slice, then parks until woken
+struct TaskIdlePolicy {
+    static constexpr unsigned int k_DefaultSpinCount = 1024;
+    static constexpr unsigned int k_DefaultYieldCount = 16;
+
+    unsigned int spinCount{k_DefaultSpinCount};
+    unsigned int yieldCount{k_DefaultYieldCount};
+};
+
+struct TaskManagerConfiguration {
+    static constexpr unsigned int k_MaxCoreCount = 1024;
+
+    // Zero means one worker per core which is not reserved
+    unsigned int workerCount{};
+    // Pin each worker to a core which is not reserved, only supported on Linux
+    bool pinWorkers{};
+    // Cores left to the main thread and other processes
+    std::bitset<k_MaxCoreCount> reservedCoreMask;
+    // Max count of workers executing background tasks at the same time
+    // Zero means a quarter of the workers, at least one
+    unsigned int maxBackgroundWorkerCount{};
+    TaskIdlePolicy idlePolicy;
+};
+
 class TaskManager {
   public:
-    static constexpr unsigned int k_WorkerCount = 8;
+    // Max count of tasks a worker moves from the shared queue to its own deque at once
+    static constexpr unsigned int k_MaxFetchCount = 64;
+    // Max nesting of tasks executed by a thread while waiting in TaskHandle::complete()
+    static constexpr unsigned int k_MaxHelpDepth = 64;
 
-    TaskManager();
+    TaskManager() : TaskManager(TaskManagerConfiguration{}) {}
+    TaskManager(const TaskManagerConfiguration& configuration);
     ~TaskManager();
 
-    std::shared_ptr<TaskHandle> schedule(std::function<void()> const& procedure);
-    std::shared_ptr<TaskHandle> schedule(std::function<void()> const& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors);
-    std::shared_ptr<TaskHandle> schedule(std::function<void()> const& procedure, std::vector<std::shared_ptr<TaskHandle>>&& predecessors);
+    // Name is only used by tracing, it should be a string literal or outlive the trace
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> schedule(Procedure&& procedure, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> schedule(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> schedule(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>>&& predecessors, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    // Queue a task at once without waiting for activateWaitingTasks, it could be called from any thread including workers
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> spawn(Procedure&& procedure, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    // Continuation, which is queued as soon as all predecessors are finished without waiting for activateWaitingTasks
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> spawn(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    // Schedule a task for each procedure, the returned join is finished after all of them
+    // The tasks are queued together with a single lock and wake, once they are activated and all predecessors are finished
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> scheduleBatch(std::span<Procedure> procedures, std::vector<std::shared_ptr<TaskHandle>> const& predecessors = {}, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    // Tasks which only run on the main thread, which is the thread creating the TaskManager, for work such as window events and presentation
+    // They are activated like scheduled tasks, and executed while the main thread waits in TaskHandle::complete() or calls executeMainThreadTasks()
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> scheduleOnMainThread(Procedure&& procedure, const char* name = nullptr);
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> scheduleOnMainThread(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const char* name = nullptr);
+    // The combined task is empty, it is finished by the last predecessor without being queued
     std::shared_ptr<TaskHandle> combine(std::vector<std::shared_ptr<TaskHandle>> const& taskHandles);
+    // Call function(rangeBegin, rangeEnd) for each block [begin + k * grain, begin + (k + 1) * grain) of the range
+    // The range is recursively halved at multiples of grain, and idle workers steal the upper halves
+    template <typename Function>
+    std::shared_ptr<TaskHandle> parallelFor(const unsigned int& begin, const unsigned int& end, const unsigned int& grain, Function&& function, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
+    template <typename Function>
+    std::shared_ptr<TaskHandle> parallelFor(const unsigned int& begin, const unsigned int& end, const unsigned int& grain, Function&& function, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority = TaskPriority::Normal, const char* name = nullptr);
     // Scheduled tasks won't be able to executed at once, because they are put in a waiting queue
     // Calling this function will activate tasks in the waiting queue
+    // Scheduling is thread-safe, but tasks scheduled by workers also wait for the activation, spawn them to run at once
     void activateWaitingTasks();
+    // Execute ready main thread tasks until there is none, it should be called from the main thread
+    void executeMainThreadTasks();
+
+    // Write executed tasks as Chrome trace events, the trace is empty unless MELON_TASK_TRACING is defined
+    // It should be called while no task is executing
+    void writeTrace(std::ostream& stream) const;
+
+    // Workers take the new policy the next time they become idle
+    void setIdlePolicy(const TaskIdlePolicy& idlePolicy);
+    TaskIdlePolicy idlePolicy() const;
+
+    unsigned int workerCount() const { return static_cast<unsigned int>(m_Workers.size()); }
+    // Workers take indices in [0, workerCount()), and other threads take workerCount()
+    unsigned int currentThreadIndex() const;
 
   private:
-    void queueTask(std::shared_ptr<TaskHandle> const& taskHandle);
-    std::shared_ptr<TaskHandle> getNextTask();
+    template <typename Function>
+    struct ParallelForState {
+        Function function;
+        unsigned int grain;
+        TaskPriority priority;
+        const char* name;
+        std::atomic<unsigned int> remainingBlockCount;
+        // Finished by the last block instead of being queued
+        std::shared_ptr<TaskHandle> join;
+    };
+
+    struct BatchState {
+        std::atomic<unsigned int> remainingTaskCount;
+        // Finished by the last task instead of being queued
+        std::shared_ptr<TaskHandle> join;
+    };
 
-    bool m_Stopped{};
+    // TaskHandle and its shared_ptr control block are allocated together from the TaskMemoryPool
+    template <typename Procedure>
+    std::shared_ptr<TaskHandle> createTask(Procedure&& procedure, const TaskPriority& priority, const char* name = nullptr);
+    template <typename Function>
+    void runParallelFor(std::shared_ptr<ParallelForState<Function>> const& state, unsigned int rangeBegin, unsigned int rangeEnd);
+
+    // Tasks become ready on a worker are pushed to its own deque, otherwise to the shared queue
+    // The queueing task keeps running when spawning, so another worker is always woken for it
+    void queueTask(std::shared_ptr<TaskHandle> const& taskHandle, const bool& spawning = false);
+    // The main thread may be sleeping in TaskHandle::complete(), so waiting threads are woken
+    void queueMainThreadTask(std::shared_ptr<TaskHandle> const& taskHandle);
+    // Record the time for tracing the queue wait
+    void markQueued(TaskHandle* taskHandle);
+    // Queue tasks with a single lock and wake
+    void queueTasks(std::vector<std::shared_ptr<TaskHandle>> const& taskHandles);
+    // Block until a task is taken from its own deques, fetched from the shared queues or stolen from other workers
+    std::shared_ptr<TaskHandle> getNextTask(TaskWorker* worker);
+    // Return when there may be a takeable task, following the idle policy
+    void waitForTask();
+    // Try lanes from the highest priority, the background lane is skipped if not allowed or all its slots are taken
+    // Worker could be nullptr if it is called from a thread other than workers
+    std::shared_ptr<TaskHandle> fetchTask(TaskWorker* worker, const bool& allowBackground, const bool& ownDequeOnly = false);
+    std::shared_ptr<TaskHandle> fetchTask(TaskWorker* worker, const TaskPriority& priority, const bool& ownDequeOnly);
+    std::shared_ptr<TaskHandle> fetchMainThreadTask();
+    void executeTask(std::shared_ptr<TaskHandle> const& task);
+    bool hasTakeableTask(const bool& allowBackground) const;
+    bool acquireBackgroundSlot();
+    // Execute ready tasks on the calling thread, sleep only if there is nothing to do
+    void helpUntilFinished(TaskHandle* taskHandle);
+    // Wake up to count parked workers, threads waiting in TaskHandle::complete() are also woken to help with new tasks
+    void wakeWorkers(const unsigned int& count);
+    void wakeWaitingThreads();
+
+    const std::thread::id m_MainThreadId;
+    std::atomic<bool> m_Stopped{};
+    std::mutex m_WaitingTaskMutex;
     std::queue<std::shared_ptr<TaskHandle>> m_WaitingTaskQueue;
     std::queue<std::pair<std::shared_ptr<TaskHandle>, std::vector<std::shared_ptr<TaskHandle>>>> m_WaitingTaskAndPredecessorsQueue;
-    std::queue<std::shared_ptr<TaskHandle>> m_TaskQueue;
+    std::array<std::queue<std::shared_ptr<TaskHandle>>, k_TaskPriorityCount> m_TaskQueues;
+    // Guarded by m_TaskQueueMutex as well
+    std::queue<std::shared_ptr<TaskHandle>> m_MainThreadTaskQueue;
+    std::atomic<unsigned int> m_MainThreadTaskCount{};
     std::mutex m_TaskQueueMutex;
-    std::condition_variable m_TaskQueueConditionVariable;
-    std::array<std::unique_ptr<TaskWorker>, k_WorkerCount> m_Workers;
+    // Count of tasks in the shared queue and all worker deques for each lane
+    std::array<std::atomic<unsigned int>, k_TaskPriorityCount> m_QueuedTaskCounts{};
+    unsigned int m_MaxBackgroundWorkerCount;
+    std::atomic<unsigned int> m_RunningBackgroundTaskCount{};
+    std::atomic<unsigned int> m_IdleSpinCount;
+    std::atomic<unsigned int> m_IdleYieldCount;
+    // Count of parked workers
+    std::atomic<unsigned int> m_SleepingWorkerCount{};
+    // Parked workers wait for it to change
+    std::atomic<unsigned int> m_WakeEpoch{};
+    // Count of threads sleeping in TaskHandle::complete()
+    std::atomic<unsigned int> m_WaitingThreadCount{};
+    std::mutex m_SleepMutex;
+    std::condition_variable m_WaitingThreadConditionVariable;
+    std::vector<std::unique_ptr<TaskWorker>> m_Workers;
+#ifdef MELON_TASK_TRACING
+    TaskTracer m_TaskTracer;
+#endif
 
+    friend class TaskGraph;
+    friend class TaskGroup;
     friend class TaskHandle;
+    friend class TaskPromiseBase;
     friend class TaskWorker;
 };
 
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::schedule(Procedure&& procedure, const TaskPriority& priority, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), priority, name);
+    std::lock_guard lock(m_WaitingTaskMutex);
+    m_WaitingTaskQueue.emplace(taskHandle);
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::schedule(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), priority, name);
+    std::lock_guard lock(m_WaitingTaskMutex);
+    m_WaitingTaskAndPredecessorsQueue.emplace(taskHandle, predecessors);
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::schedule(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>>&& predecessors, const TaskPriority& priority, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), priority, name);
+    std::lock_guard lock(m_WaitingTaskMutex);
+    m_WaitingTaskAndPredecessorsQueue.emplace(taskHandle, std::move(predecessors));
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::scheduleOnMainThread(Procedure&& procedure, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), TaskPriority::Critical, name);
+    taskHandle->m_MainThreadOnly = true;
+    std::lock_guard lock(m_WaitingTaskMutex);
+    m_WaitingTaskQueue.emplace(taskHandle);
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::scheduleOnMainThread(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), TaskPriority::Critical, name);
+    taskHandle->m_MainThreadOnly = true;
+    std::lock_guard lock(m_WaitingTaskMutex);
+    m_WaitingTaskAndPredecessorsQueue.emplace(taskHandle, predecessors);
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::spawn(Procedure&& procedure, const TaskPriority& priority, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), priority, name);
+    queueTask(taskHandle, true);
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::spawn(Procedure&& procedure, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority, const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = createTask(std::forward<Procedure>(procedure), priority, name);
+    taskHandle->initPredecessors(predecessors);
+    return taskHandle;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::scheduleBatch(std::span<Procedure> procedures, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority, const char* name) {
+    if (procedures.empty()) return combine(predecessors);
+    std::shared_ptr<BatchState> state = std::allocate_shared<BatchState>(TaskAllocator<BatchState>(), static_cast<unsigned int>(procedures.size()), createTask(nullptr, priority));
+    std::vector<std::shared_ptr<TaskHandle>> taskHandles;
+    taskHandles.reserve(procedures.size());
+    for (Procedure& procedure : procedures)
+        taskHandles.push_back(createTask(
+            [procedure = procedure, state]() mutable {
+                procedure();
+                if (--state->remainingTaskCount == 0)
+                    state->join->notifyFinished();
+            },
+            priority, name));
+    if (predecessors.empty()) {
+        std::lock_guard lock(m_WaitingTaskMutex);
+        for (std::shared_ptr<TaskHandle>& taskHandle : taskHandles)
+            m_WaitingTaskQueue.emplace(std::move(taskHandle));
+    } else
+        // A single task waits for the predecessors instead of each one, and queues all of them at once
+        schedule([this, taskHandles = std::move(taskHandles)]() { queueTasks(taskHandles); }, predecessors, TaskPriority::Critical);
+    return state->join;
+}
+
+template <typename Function>
+std::shared_ptr<TaskHandle> TaskManager::parallelFor(const unsigned int& begin, const unsigned int& end, const unsigned int& grain, Function&& function, const TaskPriority& priority, const char* name) {
+    return parallelFor(begin, end, grain, std::forward<Function>(function), std::vector<std::shared_ptr<TaskHandle>>(), priority, name);
+}
+
+template <typename Function>
+std::shared_ptr<TaskHandle> TaskManager::parallelFor(const unsigned int& begin, const unsigned int& end, const unsigned int& grain, Function&& function, std::vector<std::shared_ptr<TaskHandle>> const& predecessors, const TaskPriority& priority, const char* name) {
+    using State = ParallelForState<std::decay_t<Function>>;
+    const unsigned int blockGrain = std::max(grain, 1U);
+    const unsigned int blockCount = begin < end ? (end - begin - 1) / blockGrain + 1 : 0;
+    std::shared_ptr<State> state = std::allocate_shared<State>(TaskAllocator<State>(), std::forward<Function>(function), blockGrain, priority, name, blockCount, createTask(nullptr, priority));
+    schedule(
+        [this, state, begin, end]() {
+            if (begin < end)
+                runParallelFor(state, begin, end);
+            else
+                state->join->notifyFinished();
+        },
+        predecessors, priority, name);
+    return state->join;
+}
+
+template <typename Procedure>
+std::shared_ptr<TaskHandle> TaskManager::createTask(Procedure&& procedure, const TaskPriority& priority, [[maybe_unused]] const char* name) {
+    std::shared_ptr<TaskHandle> taskHandle = std::allocate_shared<TaskHandle>(TaskAllocator<TaskHandle>(), this, std::forward<Procedure>(procedure), priority);
+#ifdef MELON_TASK_TRACING
+    taskHandle->m_Name = name;
+#endif
+    return taskHandle;
+}
+
+template <typename Function>
+void TaskManager::runParallelFor(std::shared_ptr<ParallelForState<Function>> const& state, unsigned int rangeBegin, unsigned int rangeEnd) {
+    while (rangeEnd - rangeBegin > state->grain) {
+        const unsigned int blockCount = (rangeEnd - rangeBegin - 1) / state->grain + 1;
+        const unsigned int rangeMiddle = rangeBegin + blockCount / 2 * state->grain;
+        spawn([this, state, rangeMiddle, rangeEnd]() { runParallelFor(state, rangeMiddle, rangeEnd); }, state->priority, state->name);
+        rangeEnd = rangeMiddle;
+    }
+    state->function(rangeBegin, rangeEnd);
+    if (--state->remainingBlockCount == 0)
+        state->join->notifyFinished();
+}
+
+inline void TaskManager::markQueued([[maybe_unused]] TaskHandle* taskHandle) {
+#ifdef MELON_TASK_TRACING
+    taskHandle->m_QueuedTime = m_TaskTracer.now();
+#endif
+}
+
 }  // namespace Melon
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace Melon {
+
+// Workers drain higher lanes first
+enum class TaskPriority : unsigned int {
+    // Work the current frame is waiting for, such as rendering
+    Critical,
+    Normal,
+    // Long running work, only a limited count of workers could be occupied by it
+    Background,
+};
+
+static constexpr unsigned int k_TaskPriorityCount = 3;
+
+}  // namespace Melon
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Melon {
+
+// Type-erased callable which stores small procedures inline instead of allocating like std::function
+class TaskProcedure {
+  public:
+    static constexpr std::size_t k_InlineSize = 64;
+
+    TaskProcedure() {}
+    TaskProcedure(std::nullptr_t) {}
+    template <typename Procedure>
+    TaskProcedure(Procedure&& procedure);
+    TaskProcedure(const TaskProcedure&) = delete;
+    ~TaskProcedure();
+
+    explicit operator bool() const { return m_Invoke != nullptr; }
+    void operator()() { m_Invoke(m_Storage); }
+
+  private:
+    template <typename Callable>
+    static constexpr bool storedInline() { return sizeof(Callable) <= k_InlineSize && alignof(Callable) <= alignof(std::max_align_t); }
+
+    void (*m_Invoke)(void*){};
+    void (*m_Destroy)(void*){};
+    alignas(std::max_align_t) std::byte m_Storage[k_InlineSize];
+};
+
+template <typename Procedure>
+inline TaskProcedure::TaskProcedure(Procedure&& procedure) {
+    using Callable = std::decay_t<Procedure>;
+    // Empty std::function or null function pointer
+    if constexpr (std::is_constructible_v<bool, const Callable&>)
+        if (!static_cast<bool>(procedure)) return;
+    if constexpr (storedInline<Callable>()) {
+        new (m_Storage) Callable(std::forward<Procedure>(procedure));
+        m_Invoke = [](void* storage) { (*std::launder(reinterpret_cast<Callable*>(storage)))(); };
+        m_Destroy = [](void* storage) { std::launder(reinterpret_cast<Callable*>(storage))->~Callable(); };
+    } else {
+        new (m_Storage) Callable*(new Callable(std::forward<Procedure>(procedure)));
+        m_Invoke = [](void* storage) { (**reinterpret_cast<Callable**>(storage))(); };
+        m_Destroy = [](void* storage) { delete *reinterpret_cast<Callable**>(storage); };
+    }
+}
+
+inline TaskProcedure::~TaskProcedure() {
+    if (m_Destroy)
+        m_Destroy(m_Storage);
+}
+
+}  // namespace Melon
@@ -0,0 +1,88 @@
+#ifdef MELON_TASK_TRACING
+
+#include <MelonTask/TaskTracer.h>
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Melon {
+
+namespace {
+
+struct RingBufferCache {
+    std::uint64_t tracerId;
+    void* ringBuffer;
+};
+
+std::atomic<std::uint64_t> g_TracerIdCounter{1};
+thread_local RingBufferCache t_RingBufferCache{};
+
+void writeName(std::ostream& stream, const char* name) {
+    stream << '"';
+    for (const char* c = name; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            stream << '\\';
+        stream << *c;
+    }
+    stream << '"';
+}
+
+}  // namespace
+
+TaskTracer::TaskTracer() : m_Id(g_TracerIdCounter++), m_StartTime(std::chrono::steady_clock::now()) {}
+
+void TaskTracer::record(const unsigned int& threadIndex, const Event& event) {
+    RingBuffer* buffer = t_RingBufferCache.tracerId == m_Id ? static_cast<RingBuffer*>(t_RingBufferCache.ringBuffer) : ringBuffer(threadIndex);
+    const std::uint64_t eventCount = buffer->eventCount.load(std::memory_order_relaxed);
+    buffer->events[eventCount % k_RingBufferCapacity] = event;
+    buffer->eventCount.store(eventCount + 1, std::memory_order_release);
+}
+
+void TaskTracer::write(std::ostream& stream, const unsigned int& workerCount) const {
+    std::lock_guard lock(m_RingBufferMutex);
+    // Times are microseconds with nanosecond decimals, the default format switches to scientific notation after a second
+    const std::ios_base::fmtflags flags = stream.flags();
+    const std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\"traceEvents\":[";
+    for (unsigned int tid = 0; tid < m_RingBuffers.size(); tid++) {
+        RingBuffer const& buffer = *m_RingBuffers[tid].second;
+        stream << (tid == 0 ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\"";
+        if (buffer.threadIndex < workerCount)
+            stream << "Worker " << buffer.threadIndex;
+        else
+            stream << "Thread " << tid;
+        stream << "\"}}";
+        const std::uint64_t eventCount = buffer.eventCount.load(std::memory_order_acquire);
+        for (std::uint64_t i = eventCount - std::min<std::uint64_t>(eventCount, k_RingBufferCapacity); i < eventCount; i++) {
+            Event const& event = buffer.events[i % k_RingBufferCapacity];
+            // Chrome trace takes microseconds
+            stream << ",\n{\"name\":";
+            writeName(stream, event.name ? event.name : "Task");
+            stream << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid << ",\"ts\":" << event.beginTime / 1e3 << ",\"dur\":" << (event.endTime - event.beginTime) / 1e3;
+            stream << ",\"args\":{\"queueWait\":" << (event.beginTime - std::min(event.queuedTime, event.beginTime)) / 1e3 << "}}";
+        }
+    }
+    stream << "\n]}\n";
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+TaskTracer::RingBuffer* TaskTracer::ringBuffer(const unsigned int& threadIndex) {
+    std::lock_guard lock(m_RingBufferMutex);
+    const std::thread::id threadId = std::this_thread::get_id();
+    auto it = std::find_if(m_RingBuffers.begin(), m_RingBuffers.end(), [&threadId](auto const& pair) { return pair.first == threadId; });
+    if (it == m_RingBuffers.end()) {
+        std::unique_ptr<RingBuffer> buffer = std::make_unique<RingBuffer>();
+        buffer->threadIndex = threadIndex;
+        buffer->events = std::make_unique<Event[]>(k_RingBufferCapacity);
+        m_RingBuffers.emplace_back(threadId, std::move(buffer));
+        it = m_RingBuffers.end() - 1;
+    }
+    t_RingBufferCache = RingBufferCache{m_Id, it->second.get()};
+    return it->second.get();
+}
+
+}  // namespace Melon
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifdef MELON_TASK_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace Melon {
+
+// Records executed tasks into per-thread ring buffers, and writes them as Chrome trace events
+// Only compiled if MELON_TASK_TRACING is defined
+class TaskTracer {
+  public:
+    // The oldest events of a thread are overwritten once its ring buffer is full
+    static constexpr unsigned int k_RingBufferCapacity = 1 << 16;
+
+    // Times are in nanoseconds since the tracer is created
+    struct Event {
+        const char* name;
+        std::uint64_t queuedTime;
+        std::uint64_t beginTime;
+        std::uint64_t endTime;
+    };
+
+    TaskTracer();
+    TaskTracer(const TaskTracer&) = delete;
+
+    std::uint64_t now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_StartTime).count(); }
+    // Lock-free once the calling thread has recorded its first event
+    void record(const unsigned int& threadIndex, const Event& event);
+    // Threads with indices less than workerCount are named as workers
+    // It should be called while no task is executing
+    void write(std::ostream& stream, const unsigned int& workerCount) const;
+
+  private:
+    struct RingBuffer {
+        unsigned int threadIndex;
+        std::unique_ptr<Event[]> events;
+        // Only written by the owner thread
+        std::atomic<std::uint64_t> eventCount;
+    };
+
+    RingBuffer* ringBuffer(const unsigned int& threadIndex);
+
+    // Distinguish tracers in the cache of each thread, even if a tracer is created at the address of a destroyed one
+    const std::uint64_t m_Id;
+    const std::chrono::steady_clock::time_point m_StartTime;
+    mutable std::mutex m_RingBufferMutex;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<RingBuffer>>> m_RingBuffers;
+};
+
+}  // namespace Melon
+
+#endif
@@ -6,20 +6,55 @@
 #include <functional>
 #include <memory>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace Melon {
 
-TaskWorker::TaskWorker(TaskManager* taskManager) : m_TaskManager(taskManager) {
+namespace {
+
+thread_local TaskWorker* t_CurrentWorker{};
+// Used by threads other than workers
+thread_local TaskArena t_ThreadArena;
+
+}  // namespace
+
+TaskWorker::TaskWorker(TaskManager* taskManager, const unsigned int& index) : m_TaskManager(taskManager), m_Index(index) {}
+
+void TaskWorker::start() {
     m_Thread = std::thread(&TaskWorker::threadEntryPoint, this);
 }
 
+bool TaskWorker::pin(const unsigned int& core) {
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    return pthread_setaffinity_np(m_Thread.native_handle(), sizeof(cpu_set_t), &cpuSet) == 0;
+#else
+    return true;
+#endif
+}
+
+void TaskWorker::unpin() {
+#ifdef __linux__
+    // Workers are created by the thread constructing the TaskManager, so its affinity is the one they inherited
+    cpu_set_t cpuSet;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet) == 0)
+        pthread_setaffinity_np(m_Thread.native_handle(), sizeof(cpu_set_t), &cpuSet);
+#endif
+}
+
 void TaskWorker::threadEntryPoint() {
+    t_CurrentWorker = this;
     while (!m_Stopped) {
-        std::shared_ptr<TaskHandle> task = m_TaskManager->getNextTask();
-        if (task) {
-            task->execute();
-            task->notifyFinished();
-        }
+        std::shared_ptr<TaskHandle> task = m_TaskManager->getNextTask(this);
+        if (task)
+            m_TaskManager->executeTask(task);
     }
+    t_CurrentWorker = nullptr;
 }
 
 void TaskWorker::notify_stopped() {
@@ -30,4 +65,32 @@ void TaskWorker::join() {
     m_Thread.join();
 }
 
+TaskWorker* TaskWorker::current() {
+    return t_CurrentWorker;
+}
+
+void TaskWorker::push(std::shared_ptr<TaskHandle> const& task) {
+    // The deque stores raw pointers, the task keeps itself alive until it is taken out
+    task->m_Self = task;
+    m_TaskDeques[static_cast<unsigned int>(task->m_Priority)].push(task.get());
+}
+
+std::shared_ptr<TaskHandle> TaskWorker::pop(const TaskPriority& priority) {
+    TaskHandle* task = m_TaskDeques[static_cast<unsigned int>(priority)].pop();
+    if (!task) return nullptr;
+    m_TaskManager->m_QueuedTaskCounts[static_cast<unsigned int>(priority)].fetch_sub(1);
+    return std::move(task->m_Self);
+}
+
+std::shared_ptr<TaskHandle> TaskWorker::steal(const TaskPriority& priority) {
+    TaskHandle* task = m_TaskDeques[static_cast<unsigned int>(priority)].steal();
+    if (!task) return nullptr;
+    m_TaskManager->m_QueuedTaskCounts[static_cast<unsigned int>(priority)].fetch_sub(1);
+    return std::move(task->m_Self);
+}
+
+TaskArena& currentWorkerArena() {
+    return t_CurrentWorker ? t_CurrentWorker->arena() : t_ThreadArena;
+}
+
 }  // namespace Melon
@@ -1,22 +1,51 @@
 #pragma once
 
+#include <MelonTask/TaskArena.h>
+#include <MelonTask/TaskDeque.h>
+#include <MelonTask/TaskPriority.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
 #include <thread>
 
 namespace Melon {
 
+class TaskHandle;
 class TaskManager;
 
 class TaskWorker {
   public:
-    TaskWorker(TaskManager* taskManager);
+    TaskWorker(TaskManager* taskManager, const unsigned int& index);
+    void start();
+    // Bind the thread to a core, returns false if the core is refused, it does nothing on platforms other than Linux
+    bool pin(const unsigned int& core);
+    // Reset the thread to the affinity of the calling thread
+    void unpin();
     void threadEntryPoint();
     void notify_stopped();
     void join();
 
+    // The worker running on the calling thread, nullptr if it is not a worker thread
+    static TaskWorker* current();
+
+    const unsigned int& index() const { return m_Index; }
+    TaskArena& arena() { return m_Arena; }
+
   private:
+    void push(std::shared_ptr<TaskHandle> const& task);
+    std::shared_ptr<TaskHandle> pop(const TaskPriority& priority);
+    std::shared_ptr<TaskHandle> steal(const TaskPriority& priority);
+
     TaskManager* const m_TaskManager;
+    const unsigned int m_Index;
+    // One deque for each priority lane
+    std::array<TaskDeque<TaskHandle>, k_TaskPriorityCount> m_TaskDeques;
+    TaskArena m_Arena;
     std::thread m_Thread;
-    bool m_Stopped{};
+    std::atomic<bool> m_Stopped{};
+
+    friend class TaskManager;
 };
 
 }  // namespace Melon